@@ -20,14 +20,94 @@
 #include "board.h"
 #include "move.h"
 #include "lookups.h"
+#include "eval.h"
+#if defined(__BMI2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
 
 // zobrist hashing values 
 std::array<std::array<uint64_t, 2>, 49> zobTable;
 uint64_t zobColorToMove;
+bool canonicalHashing = false;
+// the combined key of flipping every tile in a neighborhood pattern around a square
+std::array<std::array<uint64_t, 256>, 49> flipKeys;
+
+// packs the tiles of a bitboard around a square into 8 bits, the index into flipKeys
+inline int neighborPattern(const int square, const uint64_t neighbors) {
+#ifdef __BMI2__
+    return _pext_u64(neighbors, neighboringTiles[square]);
+#else
+    // move the 3x3 block into the bottom 17 bits (shifted up first so squares on the bottom row don't go negative),
+    // the rows are 7 apart so the row below is bits 0-2, the sides are bits 7 and 9, and the row above is bits 14-16
+    const uint64_t window = ((neighbors & neighboringTiles[square]) << 8) >> square;
+    return (window & 0x7) | ((window >> 4) & 0x8) | ((window >> 5) & 0x10) | ((window >> 9) & 0xE0);
+#endif
+}
+
+#ifdef __AVX512F__
+// ringShift for the 8 directions from first onwards at once, pieces is broadcast to every lane
+inline __m512i ringShift8(const __m512i pieces, const int first) {
+    const __m512i sources = _mm512_and_si512(pieces, _mm512_load_si512(&ringDirections.sourceMasks[first]));
+    // the maskz forms all lanes on, the plain ones make gcc warn about their undefined passthrough
+    return _mm512_maskz_srlv_epi64(0xFF, _mm512_maskz_sllv_epi64(0xFF, sources, _mm512_load_si512(&ringDirections.leftShifts[first])),
+        _mm512_load_si512(&ringDirections.rightShifts[first]));
+}
+#endif
+
+// fills in the squares each direction of double move can reach, one bitboard per direction
+inline void doubleMoveTargets(const uint64_t pieces, const uint64_t empty, std::array<uint64_t, 16> &targets) {
+#ifdef __AVX512F__
+    const __m512i piecesVector = _mm512_set1_epi64(pieces);
+    const __m512i emptyVector = _mm512_set1_epi64(empty);
+    for(int i = 0; i < 16; i += 8) {
+        const __m512i shifted = ringShift8(piecesVector, i);
+        _mm512_storeu_si512(&targets[i], _mm512_and_si512(shifted, emptyVector));
+    }
+#else
+    for(int direction = 0; direction < 16; direction++) {
+        targets[direction] = ringShift(pieces, direction) & empty;
+    }
+#endif
+}
+
+// counts the double moves, each one lands in exactly one direction so the counts just add up
+inline int countDoubleMoves(const uint64_t pieces, const uint64_t empty) {
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+    const __m512i piecesVector = _mm512_set1_epi64(pieces);
+    const __m512i emptyVector = _mm512_set1_epi64(empty);
+    __m512i counts = _mm512_setzero_si512();
+    for(int i = 0; i < 16; i += 8) {
+        const __m512i shifted = ringShift8(piecesVector, i);
+        counts = _mm512_add_epi64(counts, _mm512_popcnt_epi64(_mm512_and_si512(shifted, emptyVector)));
+    }
+    const __m256i halves = _mm256_add_epi64(_mm512_maskz_extracti64x4_epi64(0xF, counts, 0), _mm512_maskz_extracti64x4_epi64(0xF, counts, 1));
+    const __m128i quarters = _mm_add_epi64(_mm256_castsi256_si128(halves), _mm256_extracti128_si256(halves, 1));
+    return _mm_cvtsi128_si64(quarters) + _mm_extract_epi64(quarters, 1);
+#else
+    int total = 0;
+    for(int direction = 0; direction < 16; direction++) {
+        total += __builtin_popcountll(ringShift(pieces, direction) & empty);
+    }
+    return total;
+#endif
+}
 
 // makes a move on the board, and updates all values accordingly
+// the color is the side to move, as a template parameter so that every color index is a constant
+template <int color>
 void Board::makeMove(const Move move) {
+    assert(sideToMove == color);
+#ifndef NDEBUG
+    const uint64_t expectedHash = keyAfter(move);
+    int symmetry;
+#endif
+    // only a game sent over uai could ever get this long, and undoing that far back never happens
+    if(stateHistory.full()) {
+        stateHistory.dropOldest();
+        accumulatorHistory.dropOldest();
+    }
     stateHistory.push_back(currentState);
+    accumulatorHistory.push_back(accumulator);
     const int startSquare = move.getStartSquare();
     const int endSquare = move.getEndSquare();
     const int flag = move.getFlag();
@@ -39,43 +119,37 @@ void Board::makeMove(const Move move) {
     switch(flag) {
         case Single:
             currentState.hundredPlyCounter = 0;
-            addTile(endSquare);
-            flipNeighboringTiles(endSquare);
+            addTile<color>(endSquare);
+            flipNeighboringTiles<color>(endSquare);
             break;
         case Double:
-            removeTile(startSquare);
-            addTile(endSquare);
-            flipNeighboringTiles(endSquare);
+            removeTile<color>(startSquare);
+            addTile<color>(endSquare);
+            flipNeighboringTiles<color>(endSquare);
             break;
     }
-    sideToMove = 1 - sideToMove;
+    sideToMove = 1 - color;
     currentState.zobristHash ^= zobColorToMove;
+    if(canonicalHashing) {
+        for(uint64_t &hash : currentState.symmetricHashes) {
+            hash ^= zobColorToMove;
+        }
+    }
+    assert(getCanonicalHash(symmetry) == expectedHash);
+    assert(zobristCheck());
+    assert(currentState.pieceCounts[X] == __builtin_popcountll(currentState.bitboards[X]));
+    assert(currentState.pieceCounts[O] == __builtin_popcountll(currentState.bitboards[O]));
+    assert(currentState.singleReach[X] == expandBitboard(currentState.bitboards[X]));
+    assert(currentState.singleReach[O] == expandBitboard(currentState.bitboards[O]));
 }
 
 // gets all of the moves that are availible in the current position
+template <int color>
 int Board::getMoves(std::array<Move, 194> &moves) const {
     if(currentState.hundredPlyCounter < 100) {
-        uint64_t stmPieces = currentState.bitboards[sideToMove];
-        const uint64_t emptyBitboard = ~(currentState.bitboards[X] | currentState.bitboards[O]);
-        uint64_t singleMoves = expandBitboard(stmPieces) & emptyBitboard;
-        singleMoves ^= (currentState.bitboards[Blocked] & singleMoves);
-        int totalMoves = 0;
-        while(singleMoves != 0) {
-            const int index = popLSB(singleMoves);
-            moves[totalMoves] = Move(0, index, Single);
-            totalMoves++;   
-        }
-        while(stmPieces != 0) {
-            const int index = popLSB(stmPieces);
-            uint64_t twoAways = nextDoorTiles[index] & emptyBitboard;
-            twoAways ^= (currentState.bitboards[Blocked] & twoAways);
-            while(twoAways != 0) {
-                const int moveEndSquare = popLSB(twoAways);
-                moves[totalMoves] = Move(index, moveEndSquare, Double);
-                totalMoves++;   
-            }
-        }
-        if(totalMoves == 0 && __builtin_popcountll(currentState.bitboards[sideToMove]) != 0) {
+        int totalMoves = getSingleMoves<color>(moves, 0);
+        totalMoves = getDoubleMoves<color>(moves, totalMoves);
+        if(totalMoves == 0 && currentState.pieceCounts[color] != 0) {
             moves[totalMoves] = Move(0,0,Passing);
             totalMoves++;
         }
@@ -84,22 +158,79 @@ int Board::getMoves(std::array<Move, 194> &moves) const {
     return 0;
 }
 
+// adds the single moves to the list after the first count moves, and returns the new total
+// these and the double moves don't check the 100 ply rule or add passes, getMoves does that
+template <int color>
+int Board::getSingleMoves(std::array<Move, 194> &moves, int count) const {
+    const uint64_t emptyBitboard = ~(currentState.bitboards[X] | currentState.bitboards[O] | currentState.bitboards[Blocked]);
+    uint64_t singleMoves = currentState.singleReach[color] & emptyBitboard;
+    while(singleMoves != 0) {
+        moves[count] = Move(0, popLSB(singleMoves), Single);
+        count++;
+    }
+    return count;
+}
+
+// adds the double moves to the list after the first count moves, and returns the new total
+template <int color>
+int Board::getDoubleMoves(std::array<Move, 194> &moves, int count) const {
+    const uint64_t emptyBitboard = ~(currentState.bitboards[X] | currentState.bitboards[O] | currentState.bitboards[Blocked]);
+    std::array<uint64_t, 16> targets;
+    doubleMoveTargets(currentState.bitboards[color], emptyBitboard, targets);
+    for(int direction = 0; direction < 16; direction++) {
+        while(targets[direction] != 0) {
+            const int moveEndSquare = popLSB(targets[direction]);
+            moves[count] = Move(moveEndSquare - ringDirections.offsets[direction], moveEndSquare, Double);
+            count++;
+        }
+    }
+    return count;
+}
+
+// the squares any double move can land on
+template <int color>
+uint64_t Board::getDoubleReach() const {
+    const uint64_t emptyBitboard = ~(currentState.bitboards[X] | currentState.bitboards[O] | currentState.bitboards[Blocked]);
+    std::array<uint64_t, 16> targets;
+    doubleMoveTargets(currentState.bitboards[color], emptyBitboard, targets);
+    uint64_t reach = 0;
+    for(const uint64_t directionTargets : targets) {
+        reach |= directionTargets;
+    }
+    return reach;
+}
+
+// checks that a move (usually from the TT, which can hold anything) could be made in this position
+bool Board::isPseudoLegal(const Move move) const {
+    if(currentState.hundredPlyCounter >= 100) return false;
+    const uint64_t emptyBitboard = ~(currentState.bitboards[X] | currentState.bitboards[O] | currentState.bitboards[Blocked]);
+    const uint64_t endBitboard = 1ULL << move.getEndSquare();
+    switch(move.getFlag()) {
+        case Single:
+            return (currentState.singleReach[sideToMove] & emptyBitboard & endBitboard) != 0;
+        case Double:
+            return (currentState.bitboards[sideToMove] & (1ULL << move.getStartSquare())) != 0
+                && (nextDoorTiles[move.getStartSquare()] & emptyBitboard & endBitboard) != 0;
+        case Passing:
+            return currentState.pieceCounts[sideToMove] != 0
+                && (currentState.singleReach[sideToMove] & emptyBitboard) == 0
+                && countDoubleMoves(currentState.bitboards[sideToMove], emptyBitboard) == 0;
+        default:
+            return false;
+    }
+}
+
 // counts the number of moves in the position, only saves time in perft.
+template <int color>
 int Board::getMoveCount() const {
     if(currentState.hundredPlyCounter < 100) {
-        uint64_t stmPieces = currentState.bitboards[sideToMove];
-        const uint64_t emptyBitboard = ~(currentState.bitboards[X] | currentState.bitboards[O]);
-        uint64_t singleMoves = expandBitboard(stmPieces) & emptyBitboard;
-        singleMoves ^= (currentState.bitboards[Blocked] & singleMoves);
+        const uint64_t stmPieces = currentState.bitboards[color];
+        const uint64_t emptyBitboard = ~(currentState.bitboards[X] | currentState.bitboards[O] | currentState.bitboards[Blocked]);
+        const uint64_t singleMoves = currentState.singleReach[color] & emptyBitboard;
         int totalMoves = 0;
         totalMoves += __builtin_popcountll(singleMoves);
-        while(stmPieces != 0) {
-            const int index = popLSB(stmPieces);
-            uint64_t twoAways = nextDoorTiles[index] & emptyBitboard;
-            twoAways ^= (currentState.bitboards[Blocked] & twoAways);
-            totalMoves += __builtin_popcountll(twoAways);
-        }
-        if(totalMoves == 0 && __builtin_popcountll(currentState.bitboards[sideToMove]) != 0) {
+        totalMoves += countDoubleMoves(stmPieces, emptyBitboard);
+        if(totalMoves == 0 && currentState.pieceCounts[color] != 0) {
             totalMoves++;
         }
         return totalMoves;
@@ -107,15 +238,47 @@ int Board::getMoveCount() const {
     return 0;
 }
 
+template void Board::makeMove<X>(const Move move);
+template void Board::makeMove<O>(const Move move);
+template int Board::getMoves<X>(std::array<Move, 194> &moves) const;
+template int Board::getMoves<O>(std::array<Move, 194> &moves) const;
+template int Board::getMoveCount<X>() const;
+template int Board::getMoveCount<O>() const;
+template int Board::getSingleMoves<X>(std::array<Move, 194> &moves, int count) const;
+template int Board::getSingleMoves<O>(std::array<Move, 194> &moves, int count) const;
+template int Board::getDoubleMoves<X>(std::array<Move, 194> &moves, int count) const;
+template int Board::getDoubleMoves<O>(std::array<Move, 194> &moves, int count) const;
+template uint64_t Board::getDoubleReach<X>() const;
+template uint64_t Board::getDoubleReach<O>() const;
+
+// versions that pick the side to move at runtime, for everything outside of the hot loops
+void Board::makeMove(const Move move) {
+    sideToMove == X ? makeMove<X>(move) : makeMove<O>(move);
+}
+
+int Board::getMoves(std::array<Move, 194> &moves) const {
+    return sideToMove == X ? getMoves<X>(moves) : getMoves<O>(moves);
+}
+
+int Board::getMoveCount() const {
+    return sideToMove == X ? getMoveCount<X>() : getMoveCount<O>();
+}
+
+// counts the single and double moves a color has, whether or not it's their turn
+int Board::getMobility(const int color) const {
+    const uint64_t pieces = currentState.bitboards[color];
+    const uint64_t emptyBitboard = ~(currentState.bitboards[X] | currentState.bitboards[O] | currentState.bitboards[Blocked]);
+    return __builtin_popcountll(currentState.singleReach[color] & emptyBitboard) + countDoubleMoves(pieces, emptyBitboard);
+}
+
 // loads a fen into the board
 // fens have x and o for pieces, and the starting position is x5o/7/7/7/7/7/o5x x 0 1
 Board::Board(std::string fen) {
-    stateHistory.clear();
-    stateHistory.reserve(256);
     for(int i = 0; i < 3; i++) {
         currentState.bitboards[i] = 0ULL;
     }
     currentState.zobristHash = 0;
+    currentState.pieceCounts = {0, 0};
     // main board state, segment 1
     const std::vector<std::string> segments = split(fen, ' ');
     std::vector<std::string> ranks = split(segments[0], '/');
@@ -149,22 +312,53 @@ Board::Board(std::string fen) {
     currentState.hundredPlyCounter = std::stoi(segments[2]);
     // ply count, segment 4
     currentState.plyCount = std::stoi(segments[3]) * 2 - sideToMove;
+    for(int color = 0; color < 2; color++) {
+        currentState.singleReach[color] = expandBitboard(currentState.bitboards[color]);
+    }
+    blockerCount = __builtin_popcountll(currentState.bitboards[Blocked]);
+    initializeSymmetries();
+    accumulator.refresh(currentState.bitboards[X], currentState.bitboards[O]);
+}
+
+// finds the symmetries the blockers allow and calculates the hash under each of them from scratch
+void Board::initializeSymmetries() {
+    symmetries = 0;
+    for(int i = 0; i < 8; i++) {
+        if(transformBitboard(currentState.bitboards[Blocked], i) == currentState.bitboards[Blocked]) {
+            symmetries |= 1 << i;
+        }
+    }
+    for(int i = 1; i < 8; i++) {
+        uint64_t hash = (sideToMove == X ? zobColorToMove : 0);
+        for(int square = 0; square < 49; square++) {
+            const int piece = tileAtIndex(square);
+            if(piece < Blocked) hash ^= zobTable[symmetrySquares[i][square]][piece];
+        }
+        currentState.symmetricHashes[i - 1] = hash;
+    }
 }
 
 // undoes most recent move
 void Board::undoMove() {
     currentState = stateHistory.back();
     stateHistory.pop_back();
+    accumulator = accumulatorHistory.back();
+    accumulatorHistory.pop_back();
     sideToMove = 1 - sideToMove;
 }
 
 // add a tile of the current color on the board
+template <int color>
 void Board::addTile(const int square) {
     assert(square < 49);
     assert(tileAtIndex(square) == None);
     const uint64_t squareAsBitboard = 1ULL << square;
-    currentState.bitboards[sideToMove] ^= squareAsBitboard;
-    currentState.zobristHash ^= zobTable[square][sideToMove];
+    currentState.bitboards[color] ^= squareAsBitboard;
+    currentState.pieceCounts[color]++;
+    currentState.singleReach[color] |= neighboringTiles[square];
+    currentState.zobristHash ^= zobTable[square][color];
+    if(canonicalHashing) toggleSymmetricTile(square, color);
+    accumulator.addTile(square, color);
 }
 
 // adds a tile of any color to the board
@@ -173,16 +367,23 @@ void Board::initializeTile(const int square, const int color) {
     assert(tileAtIndex(square) == None);
     const uint64_t squareAsBitboard = 1ULL << square;
     currentState.bitboards[color] ^= squareAsBitboard;
+    currentState.pieceCounts[color]++;
     currentState.zobristHash ^= zobTable[square][color];
 }
 
 // takes a tile of the current color off of the board
+template <int color>
 void Board::removeTile(const int square) {
     assert(square < 49);
-    assert(tileAtIndex(square) == sideToMove);
+    assert(tileAtIndex(square) == color);
     const uint64_t squareAsBitboard = 1ULL << square;
-    currentState.bitboards[sideToMove] ^= squareAsBitboard;
-    currentState.zobristHash ^= zobTable[square][sideToMove];
+    currentState.bitboards[color] ^= squareAsBitboard;
+    currentState.pieceCounts[color]--;
+    // other tiles might still touch the squares this one did, so the reach is rebuilt rather than updated
+    currentState.singleReach[color] = expandBitboard(currentState.bitboards[color]);
+    currentState.zobristHash ^= zobTable[square][color];
+    if(canonicalHashing) toggleSymmetricTile(square, color);
+    accumulator.removeTile(square, color);
 }
 
 // blocks a tile so it can't be used
@@ -192,30 +393,40 @@ void Board::blockTile(const int square) {
     currentState.bitboards[Blocked] ^= squareAsBitboard;
 }
 
-// inverts the color of a tile
-void Board::flipTile(const int square) {
-    assert(square < 49);
-    assert(tileAtIndex(square) != sideToMove);
-    const uint64_t squareAsBitboard = 1ULL << square;
-    currentState.bitboards[sideToMove] ^= squareAsBitboard;
-    currentState.bitboards[1 - sideToMove] ^= squareAsBitboard;
-    currentState.zobristHash ^= zobTable[square][sideToMove];
-    currentState.zobristHash ^= zobTable[square][1 - sideToMove];
-}
-
 // inverts the neighboring tiles to a square
+template <int color>
 void Board::flipNeighboringTiles(const int square) {
     assert(square < 49);
-    uint64_t neighbors = (currentState.bitboards[1 - sideToMove] & neighboringTiles[square]);
+    uint64_t neighbors = (currentState.bitboards[1 - color] & neighboringTiles[square]);
     
-    currentState.bitboards[sideToMove] ^= neighbors;
-    currentState.bitboards[1 - sideToMove] ^= neighbors;
+    currentState.bitboards[color] ^= neighbors;
+    currentState.bitboards[1 - color] ^= neighbors;
+    if(neighbors != 0) {
+        const int flipped = __builtin_popcountll(neighbors);
+        currentState.pieceCounts[color] += flipped;
+        currentState.pieceCounts[1 - color] -= flipped;
+        currentState.singleReach[color] |= expandBitboard(neighbors);
+        currentState.singleReach[1 - color] = expandBitboard(currentState.bitboards[1 - color]);
+    }
 
-    // zobrist hash updates, unfortunately quite a slowdown compared to the efficient update above.
+    currentState.zobristHash ^= flipKeys[square][neighborPattern(square, neighbors)];
+    if(canonicalHashing) {
+        uint64_t toggled = neighbors;
+        while(toggled != 0) {
+            const int index = popLSB(toggled);
+            toggleSymmetricTile(index, color);
+            toggleSymmetricTile(index, 1 - color);
+        }
+    }
     while(neighbors != 0) {
-        int index = popLSB(neighbors);
-        currentState.zobristHash ^= zobTable[index][sideToMove];
-        currentState.zobristHash ^= zobTable[index][1 - sideToMove];
+        accumulator.flipTile(popLSB(neighbors), color);
+    }
+}
+
+// updates the symmetric hashes for a tile of a color appearing or disappearing
+void Board::toggleSymmetricTile(const int square, const int color) {
+    for(int i = 1; i < 8; i++) {
+        currentState.symmetricHashes[i - 1] ^= zobTable[symmetrySquares[i][square]][color];
     }
 }
 
@@ -233,8 +444,8 @@ int Board::tileAtIndex(const int square) const {
 
 // returns an evaluation of the board, or how good or bad it is for you.
 int Board::getEval() const {
-    return 100 * (__builtin_popcountll(currentState.bitboards[sideToMove]) - __builtin_popcountll(currentState.bitboards[1 - sideToMove]));
-};
+    return useNNUE ? accumulator.evaluate(sideToMove) : evaluateHCE(*this);
+}
 
 // returns the color currently to move
 int Board::getColorToMove() const {
@@ -307,6 +518,11 @@ std::string Board::getFen() const {
     return fen;
 }
 
+// returns the number of tiles a color has
+int Board::getPieceCount(const int color) const {
+    return currentState.pieceCounts[color];
+}
+
 // gets a specific bitboard
 uint64_t Board::getBitboard(int bitboard) const {
     return currentState.bitboards[bitboard];
@@ -326,6 +542,32 @@ void initializeZobrist() {
             zobTable[i][j] = dis(gen);
         }
     }
+    // flip keys, built by walking every subset of the neighbors so the index matches neighborPattern
+    for(int square = 0; square < 49; square++) {
+        const uint64_t mask = neighboringTiles[square];
+        uint64_t subset = 0;
+        do {
+            uint64_t key = 0;
+            uint64_t tiles = subset;
+            while(tiles != 0) {
+                const int index = popLSB(tiles);
+                key ^= zobTable[index][0] ^ zobTable[index][1];
+            }
+            flipKeys[square][neighborPattern(square, subset)] = key;
+            subset = (subset - mask) & mask;
+        } while(subset != 0);
+    }
+}
+
+// a fingerprint of every zobrist key, used to tie saved transposition tables to the keys that made them
+uint64_t zobristSignature() {
+    uint64_t signature = zobColorToMove;
+    for(int i = 0; i < 49; i++) {
+        for(int j = 0; j < 2; j++) {
+            signature = std::rotl(signature, 7) ^ zobTable[i][j];
+        }
+    }
+    return signature;
 }
 
 // returns the current zobrist hash
@@ -333,6 +575,53 @@ uint64_t Board::getZobristHash() const {
     return currentState.zobristHash;
 }
 
+// returns the number of plies since the last single move
+int Board::getHundredPlyCounter() const {
+    return currentState.hundredPlyCounter;
+}
+
+// calculates the hash the TT would use for the position after a move, without making it
+uint64_t Board::keyAfter(const Move move) const {
+    uint64_t best = hashAfter(move, 0, currentState.zobristHash);
+    if(!canonicalHashing) return best;
+    for(int i = 1; i < 8; i++) {
+        if((symmetries >> i) & 1) best = std::min(best, hashAfter(move, i, currentState.symmetricHashes[i - 1]));
+    }
+    return best;
+}
+
+// updates a hash of the board under a symmetry for a move
+uint64_t Board::hashAfter(const Move move, const int symmetry, uint64_t hash) const {
+    hash ^= zobColorToMove;
+    const int flag = move.getFlag();
+    if(flag == Passing) return hash;
+    const int endSquare = move.getEndSquare();
+    hash ^= zobTable[symmetrySquares[symmetry][endSquare]][sideToMove];
+    if(flag == Double) hash ^= zobTable[symmetrySquares[symmetry][move.getStartSquare()]][sideToMove];
+    uint64_t neighbors = currentState.bitboards[1 - sideToMove] & neighboringTiles[endSquare];
+    if(symmetry == 0) return hash ^ flipKeys[endSquare][neighborPattern(endSquare, neighbors)];
+    while(neighbors != 0) {
+        const int index = symmetrySquares[symmetry][popLSB(neighbors)];
+        hash ^= zobTable[index][0] ^ zobTable[index][1];
+    }
+    return hash;
+}
+
+// returns the hash used for the TT, with canonical hashing on this is the smallest hash among the symmetries
+// the blockers allow, and symmetry is set to the one that gave it
+uint64_t Board::getCanonicalHash(int &symmetry) const {
+    symmetry = 0;
+    uint64_t hash = currentState.zobristHash;
+    if(!canonicalHashing) return hash;
+    for(int i = 1; i < 8; i++) {
+        if(((symmetries >> i) & 1) && currentState.symmetricHashes[i - 1] < hash) {
+            hash = currentState.symmetricHashes[i - 1];
+            symmetry = i;
+        }
+    }
+    return hash;
+}
+
 // recalculates the zobrist hash and checks that it is identical, for debugging
 bool Board::zobristCheck() const {
     uint64_t hash = 0;
@@ -342,14 +631,24 @@ bool Board::zobristCheck() const {
     }
     if(sideToMove == X) hash ^= zobColorToMove;
 
+    if(canonicalHashing) {
+        for(int i = 1; i < 8; i++) {
+            uint64_t symmetricHash = (sideToMove == X ? zobColorToMove : 0);
+            for(int square = 0; square < 49; square++) {
+                const int piece = tileAtIndex(square);
+                if(piece < Blocked) symmetricHash ^= zobTable[symmetrySquares[i][square]][piece];
+            }
+            if(symmetricHash != currentState.symmetricHashes[i - 1]) return false;
+        }
+    }
+
     return hash == currentState.zobristHash;
 }
 
 // returns a value for if the game has ended or is still going
 int Board::getGameState() const {
-    const int selfOccupied = __builtin_popcountll(currentState.bitboards[sideToMove]);
-    const int opponentOccupied = __builtin_popcountll(currentState.bitboards[1 - sideToMove]);
-    const int blockerCount = __builtin_popcountll(currentState.bitboards[Blocked]);
+    const int selfOccupied = currentState.pieceCounts[sideToMove];
+    const int opponentOccupied = currentState.pieceCounts[1 - sideToMove];
 
     if(selfOccupied + opponentOccupied + blockerCount == 49) {
         if(selfOccupied > opponentOccupied) {
@@ -18,6 +18,7 @@
 #pragma once
 #include "global_includes.h"
 #include "move.h"
+#include "nnue.h"
 
 enum Bitboards {
     X, O, Blocked
@@ -35,36 +36,71 @@ struct BoardState {
     // x, o
     std::array<uint64_t, 3> bitboards;
     uint64_t zobristHash;
+    // the zobrist hash of the board under symmetries 1-7, only kept up to date with canonical hashing on
+    std::array<uint64_t, 7> symmetricHashes;
+    // the squares each color's tiles touch, so the targets of their single moves before removing occupied squares
+    std::array<uint64_t, 2> singleReach;
+    std::array<uint8_t, 2> pieceCounts;
     uint16_t plyCount;
     uint8_t hundredPlyCounter; 
 };
 
+// how many moves can be undone, the oldest states are forgotten in games longer than this
+constexpr int maxHistory = 1024;
+
 struct Board {
     public:
         Board(const std::string fen);
         int getMoves(std::array<Move, 194> &moves) const;
+        template <int color> int getMoves(std::array<Move, 194> &moves) const;
+        template <int color> int getSingleMoves(std::array<Move, 194> &moves, int count) const;
+        template <int color> int getDoubleMoves(std::array<Move, 194> &moves, int count) const;
+        template <int color> uint64_t getDoubleReach() const;
+        bool isPseudoLegal(const Move move) const;
         int getMoveCount() const;
+        template <int color> int getMoveCount() const;
+        int getMobility(const int color) const;
         void makeMove(const Move move);
+        template <int color> void makeMove(const Move move);
         void undoMove();
         int getEval() const;
         int getColorToMove() const;
         void toString() const;
         std::string getFen() const;
         uint64_t getBitboard(int bitboard) const;
+        int getPieceCount(const int color) const;
         uint64_t getZobristHash() const;
+        int getHundredPlyCounter() const;
+        uint64_t keyAfter(const Move move) const;
+        uint64_t getCanonicalHash(int &symmetry) const;
+        void initializeSymmetries();
         int getGameState() const;
         bool zobristCheck() const;
+        // the microbenchmark times the private primitives on their own
+        friend struct BoardBenchmark;
     private:
         BoardState currentState;
         uint8_t sideToMove;
-        std::vector<BoardState> stateHistory;
-        void addTile(const int square);
+        StaticStack<BoardState, maxHistory> stateHistory;
+        // the network's hidden layer, kept in a stack alongside the states
+        Accumulator accumulator;
+        StaticStack<Accumulator, maxHistory> accumulatorHistory;
+        // bit i is set if symmetry i maps the blockers onto themselves
+        uint8_t symmetries;
+        // blockers never change during a game
+        uint8_t blockerCount;
+        template <int color> void addTile(const int square);
         void initializeTile(const int square, const int color);
-        void removeTile(const int square);
+        template <int color> void removeTile(const int square);
         void blockTile(const int tile);
-        void flipTile(const int square);
-        void flipNeighboringTiles(const int square);
+        template <int color> void flipNeighboringTiles(const int square);
         int tileAtIndex(const int square) const;
+        void toggleSymmetricTile(const int square, const int color);
+        uint64_t hashAfter(const Move move, const int symmetry, uint64_t hash) const;
 };
 
-void initializeZobrist();
\ No newline at end of file
+// when this is on the TT is keyed by the smallest hash of the 8 symmetries of the board
+extern bool canonicalHashing;
+
+void initializeZobrist();
+uint64_t zobristSignature();
\ No newline at end of file
@@ -0,0 +1,68 @@
+/*
+    Anthraxx
+    Copyright (C) 2024 Joseph Pasfield
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "eval.h"
+#include "lookups.h"
+
+// the weight of each term in centipawns, tuned with the tune command
+std::array<int, TermCount> evalParams = {
+    100, // Material
+    4,   // Mobility
+    -8,  // Frontier
+    6,   // BlockedSafety
+    20   // Tempo
+};
+
+// off until a trained net ships, the bootstrap net is only material and the hand crafted eval has more terms
+bool useNNUE = false;
+
+/*
+    Material: tiles
+    Mobility: legal single and double moves
+    Frontier: tiles next to an empty square, these are the ones that can be flipped
+    BlockedSafety: tiles next to a blocker, which has fewer directions to be flipped from
+    Tempo: being the side to move
+*/
+EvalFeatures getEvalFeatures(const Board &board) {
+    const int colorToMove = board.getColorToMove();
+    const uint64_t blocked = board.getBitboard(Blocked);
+    const uint64_t empty = ~(board.getBitboard(X) | board.getBitboard(O) | blocked) & 0x1FFFFFFFFFFFFULL;
+    const uint64_t nextToEmpty = expandBitboard(empty);
+    const uint64_t nextToBlocker = expandBitboard(blocked);
+    EvalFeatures features = {};
+    features[Tempo] = 1;
+    for(int color = 0; color < 2; color++) {
+        const int sign = (color == colorToMove ? 1 : -1);
+        const uint64_t tiles = board.getBitboard(color);
+        features[Material] += sign * board.getPieceCount(color);
+        features[Mobility] += sign * board.getMobility(color);
+        features[Frontier] += sign * __builtin_popcountll(tiles & nextToEmpty);
+        features[BlockedSafety] += sign * __builtin_popcountll(tiles & nextToBlocker);
+    }
+    return features;
+}
+
+// evaluates the board from the side to move's perspective
+int evaluateHCE(const Board &board) {
+    const EvalFeatures features = getEvalFeatures(board);
+    int eval = 0;
+    for(int i = 0; i < TermCount; i++) {
+        eval += features[i] * evalParams[i];
+    }
+    return eval;
+}
@@ -0,0 +1,38 @@
+/*
+    Anthraxx
+    Copyright (C) 2024 Joseph Pasfield
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "global_includes.h"
+#include "board.h"
+
+// the terms of the hand crafted evaluation, each is the side to move's count minus the opponent's, besides tempo
+enum EvalTerms {
+    Material, Mobility, Frontier, BlockedSafety, Tempo, TermCount
+};
+
+constexpr std::array<std::string_view, TermCount> termNames = {
+    "Material", "Mobility", "Frontier", "BlockedSafety", "Tempo"
+};
+
+using EvalFeatures = std::array<int, TermCount>;
+
+extern std::array<int, TermCount> evalParams;
+// picks between the network and the hand crafted evaluation
+extern bool useNNUE;
+
+EvalFeatures getEvalFeatures(const Board &board);
+int evaluateHCE(const Board &board);
@@ -0,0 +1,64 @@
+/*
+    Anthraxx
+    Copyright (C) 2024 Joseph Pasfield
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "global_includes.h"
+
+// off by default, with the current network a lookup costs more than the evaluation it saves
+constexpr uint64_t defaultEvalCacheSize = 0;
+
+// caches leaf evaluations by zobrist hash, shared by every thread without any locking
+// each entry is one word holding the upper 48 bits of the hash and the 16 bit evaluation, so a hit can't be torn
+struct EvalCache {
+    public:
+        EvalCache() {
+            resize(defaultEvalCacheSize);
+        }
+        // a size of 0 turns the cache off
+        bool enabled() const {
+            return !table.empty();
+        }
+        bool probe(const uint64_t hash, int &eval) const {
+            if(table.empty()) return false;
+            const uint64_t entry = table[hash & mask].load(std::memory_order_relaxed);
+            if(((entry ^ hash) & keyMask) != 0) return false;
+            eval = static_cast<int16_t>(entry & ~keyMask);
+            return true;
+        }
+        // an eval that doesn't fit in 16 bits isn't stored, so a hit always gives back exactly what the board would
+        void store(const uint64_t hash, const int eval) {
+            if(table.empty() || eval < INT16_MIN || eval > INT16_MAX) return;
+            const uint64_t entry = (hash & keyMask) | static_cast<uint16_t>(eval);
+            table[hash & mask].store(entry, std::memory_order_relaxed);
+        }
+        void clear() {
+            for(auto &entry : table) {
+                entry.store(0, std::memory_order_relaxed);
+            }
+        }
+        // resizes the cache to the largest power of 2 number of entries that fits in the size given in megabytes, 0 turns it off
+        void resize(const uint64_t newSizeMB) {
+            const uint64_t entries = newSizeMB * 1024 * 1024 / sizeof(uint64_t);
+            table = std::vector<std::atomic<uint64_t>>(entries == 0 ? 0 : std::bit_floor(entries));
+            mask = table.empty() ? 0 : table.size() - 1;
+            clear();
+        }
+    private:
+        static constexpr uint64_t keyMask = ~0xFFFFULL;
+        std::vector<std::atomic<uint64_t>> table;
+        uint64_t mask = 0;
+};
@@ -32,6 +32,13 @@
 #include <chrono>
 #include <fstream>
 #include <memory>
+#include <cstring>
+#include <cmath>
+#include <numeric>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 constexpr int bigNumber = 1215752192;
 
@@ -56,3 +63,48 @@ inline std::vector<std::string> split(const std::string string, const char seper
     
     return list;
 }
+
+
+// a stack with its storage inline, so that it never touches the heap
+// copying one only copies the part that's in use
+template <typename T, int capacity>
+struct StaticStack {
+    public:
+        StaticStack() = default;
+        StaticStack(const StaticStack &other) {
+            *this = other;
+        }
+        StaticStack& operator=(const StaticStack &other) {
+            count = other.count;
+            std::copy(other.items.begin(), other.items.begin() + count, items.begin());
+            return *this;
+        }
+        void push_back(const T &item) {
+            assert(count < capacity);
+            items[count++] = item;
+        }
+        void pop_back() {
+            assert(count > 0);
+            count--;
+        }
+        T& back() {
+            return items[count - 1];
+        }
+        void clear() {
+            count = 0;
+        }
+        int size() const {
+            return count;
+        }
+        bool full() const {
+            return count == capacity;
+        }
+        // forgets the bottom item, to make room at the top
+        void dropOldest() {
+            std::copy(items.begin() + 1, items.begin() + count, items.begin());
+            count--;
+        }
+    private:
+        std::array<T, capacity> items;
+        int count = 0;
+};
@@ -106,3 +106,90 @@ constexpr std::array<uint64_t, 49> generateNextDoors() {
 
 constexpr std::array<uint64_t, 49> neighboringTiles = generateExpanded();
 constexpr std::array<uint64_t, 49> nextDoorTiles = generateNextDoors();
+
+/*
+    The 16 directions of a double move, the ring of squares two away. A direction moves every bit of a bitboard at once,
+    the source mask drops the squares that would land off the board, then one of the two shifts is applied
+    (the other is 0), so a shift looks the same for every direction, which also lets it be done in SIMD.
+*/
+struct RingDirections {
+    alignas(64) std::array<uint64_t, 16> sourceMasks;
+    alignas(64) std::array<uint64_t, 16> leftShifts;
+    alignas(64) std::array<uint64_t, 16> rightShifts;
+    std::array<int, 16> offsets;
+};
+
+constexpr RingDirections generateRingDirections() {
+    RingDirections directions{};
+    int direction = 0;
+    for(int rankOffset = -2; rankOffset <= 2; rankOffset++) {
+        for(int fileOffset = -2; fileOffset <= 2; fileOffset++) {
+            // only the outer ring of the 5x5 square
+            if(rankOffset != 2 && rankOffset != -2 && fileOffset != 2 && fileOffset != -2) continue;
+            uint64_t sourceMask = 0;
+            for(int square = 0; square < 49; square++) {
+                const int rank = square / 7 + rankOffset;
+                const int file = square % 7 + fileOffset;
+                if(rank >= 0 && rank < 7 && file >= 0 && file < 7) sourceMask |= 1ULL << square;
+            }
+            const int offset = rankOffset * 7 + fileOffset;
+            directions.sourceMasks[direction] = sourceMask;
+            directions.leftShifts[direction] = offset > 0 ? offset : 0;
+            directions.rightShifts[direction] = offset < 0 ? -offset : 0;
+            directions.offsets[direction] = offset;
+            direction++;
+        }
+    }
+    return directions;
+}
+
+constexpr RingDirections ringDirections = generateRingDirections();
+
+// moves every tile in a bitboard two squares in one direction
+constexpr uint64_t ringShift(const uint64_t bitboard, const int direction) {
+    return ((bitboard & ringDirections.sourceMasks[direction]) << ringDirections.leftShifts[direction]) >> ringDirections.rightShifts[direction];
+}
+
+/*
+    The 8 symmetries of the board, as where each square ends up:
+    0: identity, 1-3: rotations by 90, 180 and 270 degrees clockwise,
+    4: mirrored files, 5: mirrored ranks, 6: flipped along a1-g7, 7: flipped along a7-g1
+*/
+constexpr int transformSquare(const int square, const int symmetry) {
+    const int rank = square / 7;
+    const int file = square % 7;
+    switch(symmetry) {
+        case 1: return file * 7 + (6 - rank);
+        case 2: return (6 - rank) * 7 + (6 - file);
+        case 3: return (6 - file) * 7 + rank;
+        case 4: return rank * 7 + (6 - file);
+        case 5: return (6 - rank) * 7 + file;
+        case 6: return file * 7 + rank;
+        case 7: return (6 - file) * 7 + (6 - rank);
+        default: return square;
+    }
+}
+
+constexpr std::array<std::array<uint8_t, 49>, 8> generateSymmetrySquares() {
+    std::array<std::array<uint8_t, 49>, 8> squares;
+    for(int symmetry = 0; symmetry < 8; symmetry++) {
+        for(int square = 0; square < 49; square++) {
+            squares[symmetry][square] = transformSquare(square, symmetry);
+        }
+    }
+    return squares;
+}
+
+constexpr std::array<std::array<uint8_t, 49>, 8> symmetrySquares = generateSymmetrySquares();
+// the symmetry that undoes each symmetry, only the 90 and 270 degree rotations aren't their own inverse
+constexpr std::array<int, 8> inverseSymmetry = {0, 3, 2, 1, 4, 5, 6, 7};
+
+constexpr uint64_t transformBitboard(uint64_t bitboard, const int symmetry) {
+    uint64_t result = 0;
+    while(bitboard != 0) {
+        const int square = std::countr_zero(bitboard);
+        bitboard &= bitboard - 1;
+        result |= 1ULL << transformSquare(square, symmetry);
+    }
+    return result;
+}
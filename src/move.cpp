@@ -16,6 +16,7 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 #include "move.h"
+#include "lookups.h"
 
 Move::Move(int start, int end, int type) {
     value = start + (end << 6) + (type << 12);
@@ -31,8 +32,9 @@ int Move::getFlag() const {
     return (value >> 12);
 }
 
+// the null move, its flag doesn't exist so it can't be confused with a real move
 Move::Move() {
-    value = 0;
+    value = 0xFFFF;
 }
 
 // convert long algebraic form into a move
@@ -78,3 +80,13 @@ std::string Move::toLongAlgebraic() {
     }
     return longAlgebraic;
 }
+
+
+// maps a move onto the same move on a mirrored or rotated board
+Move Move::transform(const int symmetry) const {
+    const int flag = getFlag();
+    if(flag != Single && flag != Double) return *this;
+    // singles always have a start square of 0, or they wouldn't compare equal to the generated moves
+    if(flag == Single) return Move(0, symmetrySquares[symmetry][getEndSquare()], Single);
+    return Move(symmetrySquares[symmetry][getStartSquare()], symmetrySquares[symmetry][getEndSquare()], flag);
+}
\ No newline at end of file
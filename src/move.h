@@ -31,7 +31,18 @@ struct Move {
         Move(std::string longAlgebraic);
         Move();
         std::string toLongAlgebraic();
+        Move transform(const int symmetry) const;
         [[nodiscard]] constexpr auto operator==(const Move &other) const -> bool = default;
     private:
         uint16_t value;
 };
+
+static_assert(sizeof(Move) == 2);
+
+
+// moves and their ordering scores, kept as separate arrays so that the scores can be calculated in batches
+struct MoveList {
+    std::array<Move, 194> moves;
+    std::array<int, 194> scores;
+    int count;
+};
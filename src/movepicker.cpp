@@ -0,0 +1,227 @@
+/*
+    Anthraxx
+    Copyright (C) 2024 Joseph Pasfield
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "movepicker.h"
+#include "lookups.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX2__) && !(defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__))
+// avx2 has no popcount instruction, so count the nibbles with a lookup table and add up the bytes of each lane
+inline __m256i popcount64(const __m256i bitboards) {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowNibbles = _mm256_set1_epi8(0x0F);
+    const __m256i low = _mm256_shuffle_epi8(lookup, _mm256_and_si256(bitboards, lowNibbles));
+    const __m256i high = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(bitboards, 4), lowNibbles));
+    return _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+}
+#endif
+
+/*
+    Scores the moves from begin onwards by 20 * tiles flipped, + 10 for single moves,
+    - own tiles next to the square a double move leaves, so flips come first, then singles,
+    and of the double moves the ones that leave the fewest tiles open to recapture
+*/
+void scoreMoves(const Board &board, MoveList &moveList, const int begin) {
+    const uint64_t opponents = board.getBitboard(1 - board.getColorToMove());
+    const uint64_t own = board.getBitboard(board.getColorToMove());
+    int i = begin;
+    // batches of moves at once, with the neighbor masks gathered for the start and end squares of every move
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+    const auto *neighbors = reinterpret_cast<const long long*>(neighboringTiles.data());
+    const __m512i opponentsVector = _mm512_set1_epi64(opponents);
+    const __m512i ownVector = _mm512_set1_epi64(own);
+    for(; i + 8 <= moveList.count; i += 8) {
+        const __m256i values = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&moveList.moves[i])));
+        const __m256i starts = _mm256_and_si256(values, _mm256_set1_epi32(0b111111));
+        const __m256i ends = _mm256_and_si256(_mm256_srli_epi32(values, 6), _mm256_set1_epi32(0b111111));
+        const __m256i flags = _mm256_srli_epi32(values, 12);
+        const __m512i flips = _mm512_popcnt_epi64(_mm512_and_si512(_mm512_mask_i32gather_epi64(_mm512_setzero_si512(), 0xFF, ends, neighbors, 8), opponentsVector));
+        const __m512i exposed = _mm512_popcnt_epi64(_mm512_and_si512(_mm512_mask_i32gather_epi64(_mm512_setzero_si512(), 0xFF, starts, neighbors, 8), ownVector));
+        __m256i scores = _mm256_mullo_epi32(_mm512_maskz_cvtepi64_epi32(0xFF, flips), _mm256_set1_epi32(20));
+        scores = _mm256_add_epi32(scores, _mm256_and_si256(_mm256_cmpeq_epi32(flags, _mm256_set1_epi32(Single)), _mm256_set1_epi32(10)));
+        scores = _mm256_sub_epi32(scores, _mm256_and_si256(_mm256_cmpeq_epi32(flags, _mm256_set1_epi32(Double)), _mm512_maskz_cvtepi64_epi32(0xFF, exposed)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&moveList.scores[i]), scores);
+    }
+#elif defined(__AVX2__)
+    const auto *neighbors = reinterpret_cast<const long long*>(neighboringTiles.data());
+    const __m256i opponentsVector = _mm256_set1_epi64x(opponents);
+    const __m256i ownVector = _mm256_set1_epi64x(own);
+    // takes the low half of each 64 bit lane
+    const __m256i packLanes = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    for(; i + 4 <= moveList.count; i += 4) {
+        const __m128i values = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&moveList.moves[i])));
+        const __m128i starts = _mm_and_si128(values, _mm_set1_epi32(0b111111));
+        const __m128i ends = _mm_and_si128(_mm_srli_epi32(values, 6), _mm_set1_epi32(0b111111));
+        const __m128i flags = _mm_srli_epi32(values, 12);
+        const __m256i flips = popcount64(_mm256_and_si256(_mm256_i32gather_epi64(neighbors, ends, 8), opponentsVector));
+        const __m256i exposed = popcount64(_mm256_and_si256(_mm256_i32gather_epi64(neighbors, starts, 8), ownVector));
+        __m128i scores = _mm_mullo_epi32(_mm256_castsi256_si128(_mm256_permutevar8x32_epi32(flips, packLanes)), _mm_set1_epi32(20));
+        scores = _mm_add_epi32(scores, _mm_and_si128(_mm_cmpeq_epi32(flags, _mm_set1_epi32(Single)), _mm_set1_epi32(10)));
+        scores = _mm_sub_epi32(scores, _mm_and_si128(_mm_cmpeq_epi32(flags, _mm_set1_epi32(Double)), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(exposed, packLanes))));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&moveList.scores[i]), scores);
+    }
+#endif
+    // whatever is left over, or everything without simd
+    for(; i < moveList.count; i++) {
+        const Move move = moveList.moves[i];
+        moveList.scores[i] = 20 * __builtin_popcountll(opponents & neighboringTiles[move.getEndSquare()]);
+        moveList.scores[i] += (move.getFlag() == Single) * 10;
+        moveList.scores[i] -= (move.getFlag() == Double) * __builtin_popcountll(own & neighboringTiles[move.getStartSquare()]);
+    }
+}
+
+// clears everything, between games
+void MoveHistory::clear() {
+    for(auto &colorTable : butterfly) {
+        for(auto &fromTable : colorTable) {
+            fromTable.fill(0);
+        }
+    }
+    for(auto &fromTable : counterMoves) {
+        fromTable.fill(Move());
+    }
+}
+
+// singles have no start square, so they are keyed by their end square twice, which no double move can be
+inline int historyFrom(const Move move) {
+    return move.getFlag() == Single ? move.getEndSquare() : move.getStartSquare();
+}
+
+int MoveHistory::getHistory(const int color, const Move move) const {
+    return butterfly[color][historyFrom(move)][move.getEndSquare()];
+}
+
+// gravity, the closer the score is to the limit in the direction of the bonus the less it moves
+void MoveHistory::updateHistory(const int color, const Move move, const int bonus) {
+    int16_t &entry = butterfly[color][historyFrom(move)][move.getEndSquare()];
+    entry += bonus - entry * std::abs(bonus) / maxHistoryScore;
+}
+
+// passes and the root have no previous move worth keying on
+void MoveHistory::storeCounter(const Move previous, const Move move) {
+    if(previous.getFlag() != Single && previous.getFlag() != Double) return;
+    counterMoves[historyFrom(previous)][previous.getEndSquare()] = move;
+}
+
+Move MoveHistory::getCounter(const Move previous) const {
+    if(previous.getFlag() != Single && previous.getFlag() != Double) return Move();
+    return counterMoves[historyFrom(previous)][previous.getEndSquare()];
+}
+
+MovePicker::MovePicker(const Board &board, const Move ttMove, const MoveHistory &history, const std::array<Move, 2> &killers, const Move previousMove, MoveList &moveList)
+    : board(board), history(history), ttMove(ttMove), killers(killers), counterMove(history.getCounter(previousMove)), moveList(moveList) {
+    moveList.count = 0;
+}
+
+// takes the tt move out of the moves from begin onwards, it has already been searched
+void MovePicker::removeTTMove(const int begin) {
+    for(int i = begin; i < moveList.count; i++) {
+        if(moveList.moves[i] == ttMove) {
+            moveList.count--;
+            moveList.moves[i] = moveList.moves[moveList.count];
+            return;
+        }
+    }
+}
+
+template <int color>
+void MovePicker::scoreGenerated(const int begin) {
+    scoreMoves(board, moveList, begin);
+    for(int i = begin; i < moveList.count; i++) {
+        const Move move = moveList.moves[i];
+        moveList.scores[i] = moveList.scores[i] * staticScoreScale + history.getHistory(color, move);
+        if(move == killers[0] || move == killers[1]) moveList.scores[i] += killerBonus;
+        if(move == counterMove) moveList.scores[i] += counterBonus;
+    }
+}
+
+// selection sort, one move at a time, because a cutoff usually comes long before the end
+int MovePicker::findBest() const {
+    int best = current;
+    for(int i = current + 1; i < moveList.count; i++) {
+        if(moveList.scores[i] > moveList.scores[best]) best = i;
+    }
+    return best;
+}
+
+Move MovePicker::takeMove(const int index) {
+    std::swap(moveList.moves[index], moveList.moves[current]);
+    std::swap(moveList.scores[index], moveList.scores[current]);
+    return moveList.moves[current++];
+}
+
+// a double move flips the same tiles a single move to its end square would, but gets no bonus for being single
+template <int color>
+int MovePicker::getDoubleBound() const {
+    const uint64_t opponents = board.getBitboard(1 - color);
+    uint64_t reach = board.getDoubleReach<color>();
+    int maxFlips = 0;
+    while(reach != 0 && maxFlips < 8) {
+        maxFlips = std::max(maxFlips, __builtin_popcountll(opponents & neighboringTiles[popLSB(reach)]));
+    }
+    return 20 * maxFlips * staticScoreScale;
+}
+
+// gets the next move to search, or a null move once there are none left
+template <int color>
+Move MovePicker::nextMove() {
+    switch(stage) {
+        case TTMoveStage:
+            stage = GenerateSingles;
+            if(board.isPseudoLegal(ttMove)) {
+                ttMoveUsed = true;
+                return ttMove;
+            }
+            [[fallthrough]];
+        case GenerateSingles:
+            moveList.count = board.getSingleMoves<color>(moveList.moves, 0);
+            if(ttMoveUsed) removeTTMove(0);
+            scoreGenerated<color>(0);
+            doubleBound = getDoubleBound<color>();
+            stage = PickSingles;
+            [[fallthrough]];
+        case PickSingles:
+            if(current < moveList.count) {
+                const int best = findBest();
+                if(moveList.scores[best] >= doubleBound) return takeMove(best);
+            }
+            stage = GenerateDoubles;
+            [[fallthrough]];
+        case GenerateDoubles: {
+            const int begin = moveList.count;
+            moveList.count = board.getDoubleMoves<color>(moveList.moves, begin);
+            if(ttMoveUsed) removeTTMove(begin);
+            scoreGenerated<color>(begin);
+            stage = PickRemaining;
+            [[fallthrough]];
+        }
+        case PickRemaining:
+            if(current < moveList.count) return takeMove(findBest());
+            stage = Done;
+            // a pass is only allowed with no other moves, and with no tiles the game is already over
+            if(moveList.count == 0 && !ttMoveUsed && board.getPieceCount(color) != 0) return Move(0, 0, Passing);
+            [[fallthrough]];
+        default:
+            return Move();
+    }
+}
+
+template Move MovePicker::nextMove<X>();
+template Move MovePicker::nextMove<O>();
@@ -0,0 +1,87 @@
+/*
+    Anthraxx
+    Copyright (C) 2024 Joseph Pasfield
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include "global_includes.h"
+#include "move.h"
+#include "board.h"
+
+enum MovePickerStage {
+    TTMoveStage, GenerateSingles, PickSingles, GenerateDoubles, PickRemaining, Done
+};
+
+// deepest ply the search can reach
+constexpr int maxPly = 128;
+// history scores stay within plus or minus this
+constexpr int maxHistoryScore = 16384;
+// the move scores from scoreMoves are multiplied by this before history is added,
+// so history mostly reorders moves that flip the same number of tiles
+constexpr int staticScoreScale = 2048;
+// killers and counter moves only break ties, ahead of the flip count they cost a lot of nodes
+constexpr int killerBonus = 1024;
+constexpr int counterBonus = 1024;
+
+void scoreMoves(const Board &board, MoveList &moveList, const int begin);
+
+// what a search thread has learned about which moves cause cutoffs
+struct MoveHistory {
+    public:
+        MoveHistory() {
+            clear();
+        }
+        void clear();
+        int getHistory(const int color, const Move move) const;
+        void updateHistory(const int color, const Move move, const int bonus);
+        void storeCounter(const Move previous, const Move move);
+        Move getCounter(const Move previous) const;
+    private:
+        // indexed by [color][from][to]
+        std::array<std::array<std::array<int16_t, 49>, 49>, 2> butterfly;
+        // the move that refuted each previous move, indexed by [from][to] of the previous move
+        std::array<std::array<Move, 49>, 49> counterMoves;
+};
+
+/*
+    Hands out the moves of a node one at a time, generating them in stages so a cutoff skips the later ones:
+    1: TT Move, if it's possible in this position
+    2: Single moves that score at least as well as any double move could
+    3: Everything else by score, the double moves are only generated once the picker gets here
+    Scores are the flip based score from scoreMoves, then history, killers and the counter move
+*/
+struct MovePicker {
+    public:
+        MovePicker(const Board &board, const Move ttMove, const MoveHistory &history, const std::array<Move, 2> &killers, const Move previousMove, MoveList &moveList);
+        template <int color> Move nextMove();
+    private:
+        const Board &board;
+        const MoveHistory &history;
+        const Move ttMove;
+        const std::array<Move, 2> &killers;
+        const Move counterMove;
+        bool ttMoveUsed = false;
+        MoveList &moveList;
+        int stage = TTMoveStage;
+        int current = 0;
+        // the highest score a double move could get, singles scoring at least this are searched before doubles exist
+        int doubleBound = 0;
+        void removeTTMove(const int begin);
+        template <int color> void scoreGenerated(const int begin);
+        int findBest() const;
+        Move takeMove(const int index);
+        template <int color> int getDoubleBound() const;
+};
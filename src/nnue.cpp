@@ -0,0 +1,193 @@
+/*
+    Anthraxx
+    Copyright (C) 2024 Joseph Pasfield
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "nnue.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// the network is embedded into the binary at build time, EVALFILE is set by the makefile
+#ifndef EVALFILE
+#define EVALFILE "networks/bootstrap.nnue"
+#endif
+
+#if defined(_WIN32)
+#define NETWORK_SECTION ".section .rdata,\"dr\"\n"
+#define NETWORK_SYMBOL(name) #name
+#elif defined(__APPLE__)
+#define NETWORK_SECTION ".const_data\n"
+#define NETWORK_SYMBOL(name) "_" #name
+#else
+#define NETWORK_SECTION ".section .rodata\n"
+#define NETWORK_SYMBOL(name) #name
+#endif
+
+asm(
+    NETWORK_SECTION
+    ".global " NETWORK_SYMBOL(embeddedNetwork) "\n"
+    ".balign 64\n"
+    NETWORK_SYMBOL(embeddedNetwork) ":\n"
+    ".incbin \"" EVALFILE "\"\n"
+    ".global " NETWORK_SYMBOL(embeddedNetworkEnd) "\n"
+    NETWORK_SYMBOL(embeddedNetworkEnd) ":\n"
+    ".byte 0\n"
+    ".text\n"
+);
+
+extern "C" const unsigned char embeddedNetwork[];
+extern "C" const unsigned char embeddedNetworkEnd[];
+
+Network network;
+
+// copies the embedded network into place, the file is the raw little endian weights in the order they appear in Network
+void initializeNetwork() {
+    const size_t size = embeddedNetworkEnd - embeddedNetwork;
+    const size_t expectedSize = sizeof(int16_t) * (inputSize * hiddenSize + hiddenSize + hiddenSize * 2 + 1);
+    if(size != expectedSize) {
+        std::cout << "info string embedded network is " << size << " bytes, expected " << expectedSize << std::endl;
+        std::exit(1);
+    }
+    const unsigned char *data = embeddedNetwork;
+    auto read = [&data](auto &destination) {
+        std::memcpy(destination.data(), data, destination.size() * sizeof(int16_t));
+        data += destination.size() * sizeof(int16_t);
+    };
+    read(network.featureWeights);
+    read(network.featureBiases);
+    read(network.outputWeights);
+    std::memcpy(&network.outputBias, data, sizeof(int16_t));
+}
+
+namespace {
+    // the input a piece of a color on a square is, from a perspective
+    inline int featureIndex(const int perspective, const int square, const int color) {
+        return (color == perspective ? 0 : 49) + square;
+    }
+
+    inline const int16_t *featureRow(const int feature) {
+        return &network.featureWeights[feature * hiddenSize];
+    }
+
+    inline void addRow(std::array<int16_t, hiddenSize> &accumulator, const int16_t *row) {
+#ifdef __AVX2__
+        for(int i = 0; i < hiddenSize; i += 16) {
+            const __m256i values = _mm256_load_si256(reinterpret_cast<const __m256i*>(&accumulator[i]));
+            const __m256i weights = _mm256_load_si256(reinterpret_cast<const __m256i*>(&row[i]));
+            _mm256_store_si256(reinterpret_cast<__m256i*>(&accumulator[i]), _mm256_add_epi16(values, weights));
+        }
+#else
+        for(int i = 0; i < hiddenSize; i++) {
+            accumulator[i] += row[i];
+        }
+#endif
+    }
+
+    inline void subRow(std::array<int16_t, hiddenSize> &accumulator, const int16_t *row) {
+#ifdef __AVX2__
+        for(int i = 0; i < hiddenSize; i += 16) {
+            const __m256i values = _mm256_load_si256(reinterpret_cast<const __m256i*>(&accumulator[i]));
+            const __m256i weights = _mm256_load_si256(reinterpret_cast<const __m256i*>(&row[i]));
+            _mm256_store_si256(reinterpret_cast<__m256i*>(&accumulator[i]), _mm256_sub_epi16(values, weights));
+        }
+#else
+        for(int i = 0; i < hiddenSize; i++) {
+            accumulator[i] -= row[i];
+        }
+#endif
+    }
+
+    inline void addSubRow(std::array<int16_t, hiddenSize> &accumulator, const int16_t *addRow, const int16_t *subRow) {
+#ifdef __AVX2__
+        for(int i = 0; i < hiddenSize; i += 16) {
+            const __m256i values = _mm256_load_si256(reinterpret_cast<const __m256i*>(&accumulator[i]));
+            const __m256i added = _mm256_load_si256(reinterpret_cast<const __m256i*>(&addRow[i]));
+            const __m256i subtracted = _mm256_load_si256(reinterpret_cast<const __m256i*>(&subRow[i]));
+            _mm256_store_si256(reinterpret_cast<__m256i*>(&accumulator[i]), _mm256_sub_epi16(_mm256_add_epi16(values, added), subtracted));
+        }
+#else
+        for(int i = 0; i < hiddenSize; i++) {
+            accumulator[i] += addRow[i] - subRow[i];
+        }
+#endif
+    }
+
+    // clipped relu on one side of the hidden layer, multiplied by its output weights and summed
+    inline int32_t activateAndSum(const std::array<int16_t, hiddenSize> &accumulator, const int16_t *weights) {
+#ifdef __AVX2__
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i qa = _mm256_set1_epi16(QA);
+        __m256i sum = _mm256_setzero_si256();
+        for(int i = 0; i < hiddenSize; i += 16) {
+            __m256i values = _mm256_load_si256(reinterpret_cast<const __m256i*>(&accumulator[i]));
+            values = _mm256_min_epi16(_mm256_max_epi16(values, zero), qa);
+            const __m256i outputWeights = _mm256_load_si256(reinterpret_cast<const __m256i*>(&weights[i]));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(values, outputWeights));
+        }
+        __m128i reduced = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        reduced = _mm_add_epi32(reduced, _mm_shuffle_epi32(reduced, 0b01001110));
+        reduced = _mm_add_epi32(reduced, _mm_shuffle_epi32(reduced, 0b10110001));
+        return _mm_cvtsi128_si32(reduced);
+#else
+        int32_t sum = 0;
+        for(int i = 0; i < hiddenSize; i++) {
+            sum += std::clamp<int32_t>(accumulator[i], 0, QA) * weights[i];
+        }
+        return sum;
+#endif
+    }
+}
+
+// recalculates both perspectives from scratch
+void Accumulator::refresh(const uint64_t xBitboard, const uint64_t oBitboard) {
+    for(int perspective = 0; perspective < 2; perspective++) {
+        perspectives[perspective] = network.featureBiases;
+        for(int color = 0; color < 2; color++) {
+            uint64_t pieces = (color == 0 ? xBitboard : oBitboard);
+            while(pieces != 0) {
+                addRow(perspectives[perspective], featureRow(featureIndex(perspective, popLSB(pieces), color)));
+            }
+        }
+    }
+}
+
+void Accumulator::addTile(const int square, const int color) {
+    for(int perspective = 0; perspective < 2; perspective++) {
+        addRow(perspectives[perspective], featureRow(featureIndex(perspective, square, color)));
+    }
+}
+
+void Accumulator::removeTile(const int square, const int color) {
+    for(int perspective = 0; perspective < 2; perspective++) {
+        subRow(perspectives[perspective], featureRow(featureIndex(perspective, square, color)));
+    }
+}
+
+// a tile changing from the other color to newColor
+void Accumulator::flipTile(const int square, const int newColor) {
+    for(int perspective = 0; perspective < 2; perspective++) {
+        addSubRow(perspectives[perspective], featureRow(featureIndex(perspective, square, newColor)), featureRow(featureIndex(perspective, square, 1 - newColor)));
+    }
+}
+
+// the evaluation from the perspective of the side to move
+int Accumulator::evaluate(const int colorToMove) const {
+    int32_t sum = activateAndSum(perspectives[colorToMove], &network.outputWeights[0]);
+    sum += activateAndSum(perspectives[1 - colorToMove], &network.outputWeights[hiddenSize]);
+    return (int64_t(sum) + int64_t(network.outputBias) * QA) * evalScale / (QA * QB);
+}
@@ -0,0 +1,48 @@
+/*
+    Anthraxx
+    Copyright (C) 2024 Joseph Pasfield
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "global_includes.h"
+
+/*
+    (98 -> 32)x2 -> 1 perspective network
+    the inputs are the squares of the pieces belonging to the perspective, then the squares of the other side's pieces
+*/
+constexpr int inputSize = 98;
+constexpr int hiddenSize = 32;
+constexpr int QA = 255;
+constexpr int QB = 64;
+constexpr int evalScale = 400;
+
+struct Network {
+    alignas(32) std::array<int16_t, inputSize * hiddenSize> featureWeights;
+    alignas(32) std::array<int16_t, hiddenSize> featureBiases;
+    alignas(32) std::array<int16_t, hiddenSize * 2> outputWeights;
+    int16_t outputBias;
+};
+
+// the hidden layer from the perspective of each color
+struct alignas(32) Accumulator {
+    std::array<std::array<int16_t, hiddenSize>, 2> perspectives;
+    void refresh(const uint64_t xBitboard, const uint64_t oBitboard);
+    void addTile(const int square, const int color);
+    void removeTile(const int square, const int color);
+    void flipTile(const int square, const int newColor);
+    int evaluate(const int colorToMove) const;
+};
+
+void initializeNetwork();
@@ -19,67 +19,111 @@
 #include "global_includes.h"
 #include "lookups.h"
 
-bool timesUp = false;
+// shared between every thread, once it's set all of the searches unwind
+std::atomic<bool> timesUp = false;
 
 constexpr int winScore = 10000000;
 constexpr int lossScore = -10000000;
+// aspiration windows start this far either side of the last score, from this depth on
+constexpr int aspirationDelta = 50;
+constexpr int aspirationMinDepth = 4;
 
-int nodes = 0;
+// pruning and reductions, each can be turned off to measure what it does
+bool useLMR = true;
+bool useNullMovePruning = true;
+bool useReverseFutility = true;
+constexpr int rfpMaxDepth = 6;
+constexpr int rfpMargin = 100;
+constexpr int nmpMinDepth = 3;
+// close to a full board passing can be the best move, and the null move can't be trusted
+constexpr int nmpMinEmpty = 8;
+constexpr int lmrMinDepth = 3;
+constexpr int lmrMinMoves = 3;
+// reductions by depth and how many moves have been searched
+std::array<std::array<uint8_t, 194>, maxPly> reductions;
 
-/*
-    Orders the moves like this:
-    1: TT Move
-    2: Single Moves (10-18)
-    3: Double Moves (0-8)
-*/
-void Engine::scoreMoves(const Board &board, const std::array<Move, 194> &moves, std::array<int, 194> &moveScores, const int totalMoves, const Move ttMove) {
-    uint64_t opponents = board.getBitboard(1 - board.getColorToMove());
-    for(int i = 0; i < totalMoves; i++) {
-        Move move = moves[i];
-        if(move == ttMove) {
-            // good move from previous search
-            moveScores[i] = 100000000;
-        } else {
-            // single moves add a tile to the board so are in most cases good (though maybe less in endgames where you want control)
-            // captures are also better the more they can capture (again, in most cases)
-            uint64_t neighbors = (opponents & neighboringTiles[move.getEndSquare()]);
-            moveScores[i] = __builtin_popcountll(neighbors);
-            moveScores[i] += (move.getFlag() == Single) * 10;
+void initializeReductions() {
+    for(int depth = 1; depth < maxPly; depth++) {
+        for(int moves = 1; moves < 194; moves++) {
+            reductions[depth][moves] = static_cast<uint8_t>(0.75 + std::log(depth) * std::log(moves) / 2.25);
         }
     }
 }
 
+// evaluates the board, going through the eval cache first if there is one
+int Engine::evaluate(const Board &board) {
+    if(!evalCache->enabled()) return board.getEval();
+    const uint64_t hash = board.getZobristHash();
+    int eval;
+    evalCacheProbes++;
+    if(evalCache->probe(hash, eval)) {
+        evalCacheHits++;
+        return eval;
+    }
+    eval = board.getEval();
+    evalCache->store(hash, eval);
+    return eval;
+}
+
+// the side to move is a template parameter, so movegen and make move skip the color lookups
+// the node type is one too, so the root and pv only parts are compiled out of the non-pv nodes that make up most of the tree
+template <int color, int nodeType>
 int Engine::negamax(Board &board, int alpha, int beta, int depth, int ply) {
-    if(depth <= 0) return board.getEval();
+    constexpr bool isRoot = nodeType == Root;
+    constexpr bool isPV = nodeType != NonPV;
+    if(depth <= 0) return evaluate(board);
     // game end state checks
     int state = board.getGameState();
     if(state == Win) return winScore - ply;
     if(state == Loss) return lossScore + ply;
     if(state == Draw) return 0;
-    // time check
-    if(nodes % 1024 == 0 && std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count() > hardLimit) {
-        timesUp = true;
-        return 0;
-    }
-
-    // probe TT
-    uint64_t hash = board.getZobristHash();
-    Transposition *entry = tt->getEntry(board.getZobristHash());
+    // probe TT, moves are stored as they are on the canonical board so they need to be mapped back
+    int symmetry;
+    const uint64_t hash = board.getCanonicalHash(symmetry);
+    Transposition *entry = tt->getEntry(hash);
+    const bool ttHit = entry->matches(hash) && entry->getFlag() != Undefined;
+    const Move ttMove = ttHit ? entry->bestMove.transform(inverseSymmetry[symmetry]) : Move();
 
     // TT Cutoffs, don't do a search again if you've already done it equal or better
-    if(ply > 0 && entry->zobristKey == hash && entry->depth >= depth && (
-            entry->flag == Exact // exact score
-                || (entry->flag == BetaCutoff && entry->score >= beta) // lower bound, fail high
-                || (entry->flag == FailLow && entry->score <= alpha) // upper bound, fail low
+    if(!isRoot && ttHit && entry->depth >= depth && (
+            entry->getFlag() == Exact // exact score
+                || (entry->getFlag() == BetaCutoff && entry->score >= beta) // lower bound, fail high
+                || (entry->getFlag() == FailLow && entry->score <= alpha) // upper bound, fail low
         )) {
         return entry->score; 
     }
 
-    // get moves and score them (could be replaced if I ever staged movegen)
-    std::array<Move, 194> moves;
-    std::array<int, 194> moveScores;
-    const int totalMoves = board.getMoves(moves);
-    scoreMoves(board, moves, moveScores, totalMoves, entry->bestMove);
+    SearchStack &stack = searchStack[ply];
+    const Move previousMove = isRoot ? Move() : searchStack[ply - 1].move;
+
+    // pruning, never in the pv (which includes the root)
+    if constexpr(!isPV) {
+        const int staticEval = evaluate(board);
+
+        // reverse futility pruning, far enough above beta at low depth the opponent isn't getting back
+        if(useReverseFutility && depth <= rfpMaxDepth && staticEval - rfpMargin * depth >= beta) return staticEval;
+
+        // null move pruning, if passing still beats beta a real move almost certainly does too
+        // not after a pass, which also keeps two null moves from happening in a row
+        const int emptySquares = 49 - board.getPieceCount(X) - board.getPieceCount(O) - __builtin_popcountll(board.getBitboard(Blocked));
+        if(useNullMovePruning && depth >= nmpMinDepth && staticEval >= beta && emptySquares >= nmpMinEmpty
+                && previousMove.getFlag() != Passing) {
+            const int reduction = 3 + depth / 4;
+            stack.move = Move(0, 0, Passing);
+            board.makeMove<color>(stack.move);
+            nodes.store(nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            const int score = -negamax<1 - color, NonPV>(board, -beta, -beta + 1, depth - 1 - reduction, ply + 1);
+            board.undoMove();
+            if(shouldStop()) return 0;
+            // a mate found this way isn't proven
+            if(score >= beta) return score >= winScore - 256 ? beta : score;
+        }
+    }
+
+    // moves come out of the picker in stages, the tt move first and then the rest as they are needed
+    MovePicker picker(board, ttMove, moveHistory, stack.killers, previousMove, stack.moveList);
+    int failedCount = 0;
+    int movesSearched = 0;
 
     // values for saving to TT later
     int bestScore = -1000000;
@@ -87,25 +131,40 @@ int Engine::negamax(Board &board, int alpha, int beta, int depth, int ply) {
     int flag = FailLow;
     
     // move loop
-    for(int i = 0; i < totalMoves; i++) {
-        // Incremental Sorting
-        for(int j = i + 1; j < totalMoves; j++) {
-            if(moveScores[j] > moveScores[i]) {
-                std::swap(moveScores[j], moveScores[i]);
-                std::swap(moves[j], moves[i]);
-            }
-        }
-
-        Move move = moves[i];
+    Move move;
+    while((move = picker.nextMove<color>()) != Move()) {
+        // start loading the child's TT bucket so it is (hopefully) in cache by the time the child probes it
+        tt->prefetch(board.keyAfter(move));
 
         // make the move and call the next node        
-        board.makeMove(move);
-        nodes++;
-        const int score = -negamax(board, -beta, -alpha, depth - 1, ply + 1);
+        board.makeMove<color>(move);
+        stack.move = move;
+        // only this thread writes to its counter, so a full atomic increment isn't needed
+        nodes.store(nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        // principal variation search, the first move gets the full window and the rest only have to prove they are worse
+        int score;
+        if(movesSearched == 0) {
+            score = -negamax<1 - color, isPV ? PV : NonPV>(board, -beta, -alpha, depth - 1, ply + 1);
+        } else {
+            // late move reductions, moves this far down the ordering rarely matter so they get a shallower search first
+            int reduction = 0;
+            if(useLMR && depth >= lmrMinDepth && movesSearched >= lmrMinMoves) {
+                reduction = reductions[depth][movesSearched];
+                if constexpr(isPV) reduction--;
+                reduction = std::clamp(reduction, 0, depth - 2) & ~1;
+            }
+            score = -negamax<1 - color, NonPV>(board, -alpha - 1, -alpha, depth - 1 - reduction, ply + 1);
+            if(score > alpha && reduction > 0) score = -negamax<1 - color, NonPV>(board, -alpha - 1, -alpha, depth - 1, ply + 1);
+            // only a pv node has a window to re-search with
+            if constexpr(isPV) {
+                if(score > alpha && score < beta) score = -negamax<1 - color, PV>(board, -beta, -alpha, depth - 1, ply + 1);
+            }
+        }
+        movesSearched++;
         board.undoMove();
 
-        // backup time check
-        if(timesUp) return 0;
+        // time check, the timer thread sets this once the hard limit runs out
+        if(shouldStop()) return 0;
 
         if(score > bestScore) {
             bestScore = score;
@@ -113,23 +172,31 @@ int Engine::negamax(Board &board, int alpha, int beta, int depth, int ply) {
             if(score > alpha) {
                 alpha = score;
                 bestMove = move;
-                if(ply == 0) rootBestMove = move;
+                if constexpr(isRoot) rootBestMove = move;
                 flag = Exact;
             }
 
             if(score >= beta) {
-                bestMove = move;
-                if(ply == 0) rootBestMove = move;
                 flag = BetaCutoff;
+                // the cutoff move is rewarded and everything tried before it is punished
+                const int bonus = std::min(32 * depth * depth, 2048);
+                moveHistory.updateHistory(color, move, bonus);
+                for(int i = 0; i < failedCount; i++) {
+                    moveHistory.updateHistory(color, stack.failedMoves[i], -bonus);
+                }
+                if(stack.killers[0] != move) {
+                    stack.killers[1] = stack.killers[0];
+                    stack.killers[0] = move;
+                }
+                moveHistory.storeCounter(previousMove, move);
                 break;
             }
         }
-        
+        stack.failedMoves[failedCount++] = move;
     }
 
-    // push to TT w/ check to make sure you don't overwrite a move with a null move.
-    if(bestMove == Move() && entry->bestMove != Move()) bestMove = entry->bestMove;
-    tt->pushEntry(Transposition(hash, bestMove, flag, bestScore, depth), hash);
+    // push to TT, the entry might have been changed by another thread in the meantime but the replacement scheme copes with that
+    tt->pushEntry(entry, hash, bestMove.transform(symmetry), flag, bestScore, depth);
 
     return bestScore;
 }
@@ -145,49 +212,241 @@ void Engine::outputInfo(int score, int depth, int elapsedTime) {
         scoreString += "cp ";
         scoreString += std::to_string(score);
     }
-    std::cout << "info depth " << std::to_string(depth) << " nodes " << std::to_string(nodes) << " time " << std::to_string(elapsedTime) << " nps " << std::to_string(int(double(nodes) / (elapsedTime == 0 ? 1 : elapsedTime) * 1000)) << scoreString << " pv " << rootBestMove.toLongAlgebraic() << std::endl;
+    const uint64_t totalNodes = getTotalNodes();
+    std::cout << "info depth " << std::to_string(depth) << " nodes " << std::to_string(totalNodes) << " time " << std::to_string(elapsedTime) << " nps " << std::to_string(uint64_t(double(totalNodes) / (elapsedTime == 0 ? 1 : elapsedTime) * 1000)) << " hashfull " << std::to_string(tt->hashfull()) << scoreString << " pv " << rootBestMove.toLongAlgebraic() << std::endl;
 }
-// searches to higher depths until it's end criteria is met (soon to have aspiration windows)
-void Engine::iterativeDeepen(Board board, const int softTimeLimit, const int depth, bool info) {
-    for(int i = 1; i <= depth; i++) {
+// searches to higher depths until it's end criteria is met
+// after the first few depths the search starts with a window around the last score, and widens it whenever the score falls outside
+void Engine::iterativeDeepen(Board &board, const int softTimeLimit, const int depth, bool info) {
+    // the last ply is left for the leaves
+    const int depthLimit = std::min(depth, maxPly - 1);
+    int score = 0;
+    for(int i = 1; i <= depthLimit; i++) {
         const Move previousBest = rootBestMove;
+        rootDepth = i;
 
-        const int score = negamax(board, lossScore, winScore, i, 0);
+        // helpers on odd thread ids search one ply deeper to desync from the main thread
+        const int searchDepth = std::min(i + (threadId & 1), depthLimit);
+        int delta = aspirationDelta;
+        int alpha = lossScore;
+        int beta = winScore;
+        if(i >= aspirationMinDepth && std::abs(score) < winScore - 256) {
+            alpha = score - delta;
+            beta = score + delta;
+        }
+        while(true) {
+            score = board.getColorToMove() == X
+                ? negamax<X, Root>(board, alpha, beta, searchDepth, 0)
+                : negamax<O, Root>(board, alpha, beta, searchDepth, 0);
+            if(shouldStop()) break;
+            if(score <= alpha) {
+                alpha = std::max(score - delta, lossScore);
+            } else if(score >= beta) {
+                beta = std::min(score + delta, winScore);
+            } else {
+                break;
+            }
+            delta *= 2;
+        }
         
-        if(timesUp) {
+        if(shouldStop()) {
             rootBestMove = previousBest;
             break;
         }
-        const auto elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
+        // helpers don't report or manage time, the main thread stops them
+        if(threadId != 0) continue;
+        depthTimes.push_back(getElapsedMicroseconds());
+        const auto elapsedTime = getElapsedTime();
         if(info) outputInfo(score, i, elapsedTime);
-        if(elapsedTime > softTimeLimit) break;
+        // a stop during depth 1 waits for it to finish, but nothing deeper is started
+        if(timesUp) break;
+        // while pondering the clock isn't running yet, so keep going deeper
+        if(!pondering && elapsedTime > softTimeLimit) break;
     }
 }
 
 // get a move from the engine, triggers a search
 // has parameters for different kinds of searches
-Move Engine::think(Board board, const int softTimeLimit, const int hardTimeLimit, const int depth, bool info) {
+// infinite and ponder searches hold on to their result until they are told to stop (or ponderhit)
+// prepareSearch() has to be called by the thread starting the search first, so an early stop isn't lost
+Move Engine::think(Board &board, const int softTimeLimit, const int hardTimeLimit, const int depth, bool info, bool infinite) {
     hardLimit = hardTimeLimit;
+    // the last search's move might not even be legal here
+    rootBestMove = Move();
     nodes = 0;
-    timesUp = false;
+    evalCacheHits = 0;
+    evalCacheProbes = 0;
+    depthTimes.clear();
 
-    begin = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(timerMutex);
+        begin = std::chrono::steady_clock::now();
+    }
 
+    tt->newSearch();
+    startTimer();
+    startHelpers(board, depth);
     iterativeDeepen(board, softTimeLimit, depth, info);
+    waitForStop(infinite);
+    stop();
+    stopHelpers();
+    stopTimer();
     
     if(info) std::cout << "bestmove " << rootBestMove.toLongAlgebraic() << std::endl;
     return rootBestMove;
 }
 
-// the search used for bench, no time limit, just depth and you return the node count.
-int Engine::benchSearch(Board board, const int depth) {
+// the search used for bench, no time limit, just depth and you get the node count and timings
+BenchResult Engine::benchSearch(Board &board, const int depth) {
     hardLimit = bigNumber;
+    rootBestMove = Move();
     nodes = 0;
-    timesUp = false;
+    evalCacheHits = 0;
+    evalCacheProbes = 0;
+    depthTimes.clear();
+    prepareSearch(false);
 
-    begin = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(timerMutex);
+        begin = std::chrono::steady_clock::now();
+    }
 
+    tt->newSearch();
+    startHelpers(board, depth);
     iterativeDeepen(board, bigNumber, depth, false);
+    const int64_t elapsed = getElapsedMicroseconds();
+    stop();
+    stopHelpers();
     
-    return nodes;
+    return {getTotalNodes(), elapsed, depthTimes};
+}
+
+// forgets everything learned about move ordering, for a new game
+void Engine::newGame() {
+    clearHistory();
+    for(auto &helper : helpers) {
+        helper->clearHistory();
+    }
+}
+
+void Engine::clearHistory() {
+    moveHistory.clear();
+    for(SearchStack &stack : searchStack) {
+        stack.killers.fill(Move());
+    }
 }
+
+// sets the number of threads searching, the main thread counts as one of them
+void Engine::setThreads(const int threadCount) {
+    helpers.clear();
+    for(int i = 1; i < threadCount; i++) {
+        helpers.push_back(std::make_unique<Engine>(tt, evalCache, i));
+    }
+}
+
+// eval cache hits and probes over every thread since the last search started
+void Engine::getEvalCacheStats(uint64_t &hits, uint64_t &probes) const {
+    hits = evalCacheHits;
+    probes = evalCacheProbes;
+    for(const auto &helper : helpers) {
+        hits += helper->evalCacheHits;
+        probes += helper->evalCacheProbes;
+    }
+}
+
+// starts the helper threads on their own copies of the board, they share only the TT
+void Engine::startHelpers(const Board &board, const int depth) {
+    for(auto &helper : helpers) {
+        helper->nodes = 0;
+        helper->evalCacheHits = 0;
+        helper->evalCacheProbes = 0;
+        helper->hardLimit = bigNumber;
+        // the copy lives in the thread's state, not on the stack
+        helperThreads.emplace_back([&helper, helperBoard = board, depth]() mutable {
+            helper->iterativeDeepen(helperBoard, bigNumber, depth, false);
+        });
+    }
+}
+
+// waits for the helpers to unwind, the stop flag has to be set first
+void Engine::stopHelpers() {
+    for(auto &thread : helperThreads) {
+        thread.join();
+    }
+    helperThreads.clear();
+}
+
+// nodes searched by every thread combined
+uint64_t Engine::getTotalNodes() const {
+    uint64_t total = nodes.load(std::memory_order_relaxed);
+    for(const auto &helper : helpers) {
+        total += helper->nodes.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+
+// stops the search from any thread, wakes up the timer and anything waiting on the search
+void Engine::stop() {
+    {
+        std::lock_guard<std::mutex> lock(timerMutex);
+        timesUp = true;
+    }
+    timerSignal.notify_all();
+}
+
+// the hard limit is enforced by a timer thread, so the search itself never reads the clock
+void Engine::startTimer() {
+    if(hardLimit >= bigNumber) return;
+    timerThread = std::thread([this]() {
+        std::unique_lock<std::mutex> lock(timerMutex);
+        // while pondering there is no deadline yet, ponderhit resets begin and starts it
+        timerSignal.wait(lock, [this]() { return timesUp.load() || !pondering; });
+        const bool stopped = timerSignal.wait_until(lock, begin + std::chrono::milliseconds(hardLimit), []() { return timesUp.load(); });
+        if(!stopped) timesUp = true;
+    });
+}
+
+void Engine::stopTimer() {
+    if(timerThread.joinable()) timerThread.join();
+}
+
+// blocks until the search is stopped by the user or the timer, a ponder search also ends at ponderhit
+void Engine::waitForStop(const bool infinite) {
+    std::unique_lock<std::mutex> lock(timerMutex);
+    timerSignal.wait(lock, [this, infinite]() { return timesUp.load() || (!infinite && !pondering); });
+}
+
+// resets the stop flag and sets up pondering, called before the search thread is started
+void Engine::prepareSearch(const bool ponder) {
+    std::lock_guard<std::mutex> lock(timerMutex);
+    timesUp = false;
+    pondering = ponder;
+}
+
+// the opponent played the expected move, so the running search switches over to its normal time limits
+void Engine::ponderhit() {
+    {
+        std::lock_guard<std::mutex> lock(timerMutex);
+        if(!pondering) return;
+        begin = std::chrono::steady_clock::now();
+        pondering = false;
+    }
+    timerSignal.notify_all();
+}
+
+// time since the search started (or since ponderhit) in milliseconds
+// whether the search has to unwind, depth 1 always finishes so there is a move to play
+bool Engine::shouldStop() const {
+    return rootDepth > 1 && timesUp.load(std::memory_order_relaxed);
+}
+
+int64_t Engine::getElapsedTime() {
+    std::lock_guard<std::mutex> lock(timerMutex);
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
+}
+
+int64_t Engine::getElapsedMicroseconds() {
+    std::lock_guard<std::mutex> lock(timerMutex);
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+}
\ No newline at end of file
@@ -21,23 +21,94 @@
 #include "move.h"
 #include "board.h"
 #include "tt.h"
+#include "evalcache.h"
+#include "movepicker.h"
 
-extern bool timesUp;
+extern std::atomic<bool> timesUp;
+extern bool useLMR;
+extern bool useNullMovePruning;
+extern bool useReverseFutility;
+
+void initializeReductions();
+
+enum NodeTypes {
+    Root, PV, NonPV
+};
+
+// everything the search keeps for one ply, preallocated in the engine instead of on the stack of every call
+struct SearchStack {
+    MoveList moveList;
+    // moves that didn't cause a cutoff, they get a history malus if a later one does
+    std::array<Move, 194> failedMoves;
+    std::array<Move, 2> killers;
+    // the move being searched from this ply, for counter moves one ply down
+    Move move;
+};
+
+// what bench measures for one search
+struct BenchResult {
+    uint64_t nodes;
+    int64_t microseconds;
+    // when each depth finished, in microseconds from the start of the search
+    std::vector<int64_t> depthTimes;
+};
 
 struct Engine {
     public: 
-        Engine(TT *ttPointer) {
+        Engine(TT *ttPointer, EvalCache *evalCachePointer, int id = 0) {
             tt = ttPointer;
+            evalCache = evalCachePointer;
+            threadId = id;
+        }
+        Move think(Board &board, const int softTimeLimit, const int hardTimeLimit, const int depth, bool info, bool infinite = false);
+        BenchResult benchSearch(Board &board, const int depth);
+        void setThreads(const int threadCount);
+        int getThreadCount() const {
+            return static_cast<int>(helpers.size()) + 1;
         }
-        Move think(Board board, const int softTimeLimit, const int hardTimeLimit, const int depth, bool info);
-        int benchSearch(Board board, const int depth);
+        void stop();
+        void prepareSearch(const bool ponder);
+        void getEvalCacheStats(uint64_t &hits, uint64_t &probes) const;
+        void ponderhit();
+        void newGame();
     private:
         int hardLimit;
+        int threadId;
+        std::atomic<uint64_t> nodes;
         Move rootBestMove;
+        // the iteration being searched, a stop is only honoured once depth 1 has a move
+        int rootDepth = 0;
+        bool shouldStop() const;
         TT* tt;
+        EvalCache* evalCache;
+        uint64_t evalCacheHits = 0;
+        uint64_t evalCacheProbes = 0;
+        int evaluate(const Board &board);
+        // move ordering heuristics, each thread learns its own
+        MoveHistory moveHistory;
+        std::array<SearchStack, maxPly> searchStack;
+        void clearHistory();
         std::chrono::steady_clock::time_point begin;
-        void iterativeDeepen(Board board, const int softTimeLimit, const int depth, bool info);
-        void scoreMoves(const Board &board, const std::array<Move, 194> &moves, std::array<int, 194> &moveScores, const int totalMoves, const Move ttMove);
-        int negamax(Board &board, int alpha, int beta, int depth, int ply);
+        // lazy smp helpers, only the main engine (thread id 0) owns any
+        std::vector<std::unique_ptr<Engine>> helpers;
+        std::vector<std::thread> helperThreads;
+        // timer thread that sets the stop flag at the hard limit
+        std::thread timerThread;
+        std::mutex timerMutex;
+        std::condition_variable timerSignal;
+        void startTimer();
+        void stopTimer();
+        void waitForStop(const bool infinite);
+        int64_t getElapsedTime();
+        int64_t getElapsedMicroseconds();
+        // when each depth of the last search finished, only kept by the main thread
+        std::vector<int64_t> depthTimes;
+        // set while searching the expected position on the opponent's time
+        std::atomic<bool> pondering = false;
+        void startHelpers(const Board &board, const int depth);
+        void stopHelpers();
+        uint64_t getTotalNodes() const;
+        void iterativeDeepen(Board &board, const int softTimeLimit, const int depth, bool info);
+        template <int color, int nodeType> int negamax(Board &board, int alpha, int beta, int depth, int ply);
         void outputInfo(int score, int depth, int elapsedTime);
 };
\ No newline at end of file
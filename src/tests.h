@@ -50,28 +50,150 @@ inline void runMaskTests() {
     std::cout << "All Tests Passed" << std::endl;
 }
 
-inline uint64_t perft(Board &board, const int depth) {
+// the side to move is a template parameter, so the recursion alternates colors without ever branching on them
+template <int color>
+uint64_t perft(Board &board, const int depth) {
     // YIPPY bulk counting
-    if(depth == 1) return board.getMoveCount();
+    if(depth == 1) return board.getMoveCount<color>();
     if(depth <= 0) return 1;
     std::array<Move, 194> moves;
-    const int numMoves = board.getMoves(moves);
+    const int numMoves = board.getMoves<color>(moves);
     uint64_t result = 0;
     for(int i = 0; i < numMoves; i++) {
-        board.makeMove(moves[i]);
-        result += perft(board, depth-1);
+        board.makeMove<color>(moves[i]);
+        result += perft<1 - color>(board, depth-1);
         board.undoMove();
     }
     return result;
 }
 
-inline void runPerftTest(Board board, const int depth) {
-    clock_t start = clock();
-    const uint64_t result = perft(board, depth);
-    clock_t end = clock();
+inline uint64_t perft(Board &board, const int depth) {
+    return board.getColorToMove() == X ? perft<X>(board, depth) : perft<O>(board, depth);
+}
+
+/*
+    Perft counts by position and depth, shared by every perft thread without locking.
+    Each entry is two words, the count with the depth in its low byte, and the key xored with that,
+    so an entry torn by two threads writing at once just fails to match instead of giving a wrong count.
+*/
+struct PerftTable {
+    public:
+        explicit PerftTable(const uint64_t megabytes) {
+            uint64_t size = 1;
+            while(size * 2 * sizeof(PerftEntry) <= megabytes * 1024 * 1024) size *= 2;
+            entries = std::vector<PerftEntry>(megabytes == 0 ? 0 : size);
+            mask = size - 1;
+        }
+        bool isEmpty() const {
+            return entries.empty();
+        }
+        bool probe(const uint64_t key, const int depth, uint64_t &count) const {
+            if(entries.empty()) return false;
+            const PerftEntry &entry = entries[key & mask];
+            const uint64_t data = entry.data.load(std::memory_order_relaxed);
+            if((entry.check.load(std::memory_order_relaxed) ^ data) != key || static_cast<int>(data & 0xFF) != depth) return false;
+            count = data >> 8;
+            return true;
+        }
+        void store(const uint64_t key, const int depth, const uint64_t count) {
+            if(entries.empty()) return;
+            PerftEntry &entry = entries[key & mask];
+            const uint64_t data = (count << 8) | depth;
+            entry.check.store(key ^ data, std::memory_order_relaxed);
+            entry.data.store(data, std::memory_order_relaxed);
+        }
+    private:
+        struct PerftEntry {
+            std::atomic<uint64_t> check = 0;
+            std::atomic<uint64_t> data = 0;
+        };
+        std::vector<PerftEntry> entries;
+        uint64_t mask;
+};
+
+// the count under a position can depend on the 100 ply counter once the subtree reaches it, so it becomes part of the key
+// with CanonicalHash on, mirrored and rotated positions share the smallest of their hashes, their counts are the same
+inline uint64_t perftKey(const Board &board, const int depth) {
+    const int counter = board.getHundredPlyCounter();
+    int symmetry;
+    uint64_t key = board.getCanonicalHash(symmetry);
+    if(counter + depth > 100) key ^= (counter + 1) * 0x9E3779B97F4A7C15ULL;
+    return key;
+}
+
+template <int color>
+uint64_t hashedPerft(Board &board, const int depth, PerftTable &table) {
+    if(depth == 1) return board.getMoveCount<color>();
+    if(depth <= 0) return 1;
+    const uint64_t key = perftKey(board, depth);
+    uint64_t result = 0;
+    if(table.probe(key, depth, result)) return result;
+    std::array<Move, 194> moves;
+    const int numMoves = board.getMoves<color>(moves);
+    for(int i = 0; i < numMoves; i++) {
+        board.makeMove<color>(moves[i]);
+        result += hashedPerft<1 - color>(board, depth - 1, table);
+        board.undoMove();
+    }
+    table.store(key, depth, result);
+    return result;
+}
+
+inline uint64_t hashedPerft(Board &board, const int depth, PerftTable &table) {
+    return board.getColorToMove() == X ? hashedPerft<X>(board, depth, table) : hashedPerft<O>(board, depth, table);
+}
+
+// splits the root moves between threads, each taking the next unclaimed move until there are none left
+// counts[i] ends up as the count under moves[i], and the table is skipped entirely when it has no entries
+inline int dividedPerft(const Board &board, const int depth, const int threadCount, PerftTable &table, std::array<Move, 194> &moves, std::vector<uint64_t> &counts) {
+    const int numMoves = board.getMoves(moves);
+    counts.assign(numMoves, 0);
+    std::atomic<int> nextMove = 0;
+    std::vector<std::thread> threads;
+    for(int i = 0; i < std::max(threadCount, 1); i++) {
+        threads.emplace_back([&, threadBoard = board]() mutable {
+            for(int move = nextMove++; move < numMoves; move = nextMove++) {
+                threadBoard.makeMove(moves[move]);
+                counts[move] = table.isEmpty() ? perft(threadBoard, depth - 1) : hashedPerft(threadBoard, depth - 1, table);
+                threadBoard.undoMove();
+            }
+        });
+    }
+    for(auto &thread : threads) {
+        thread.join();
+    }
+    return numMoves;
+}
+
+inline uint64_t parallelPerft(const Board &board, const int depth, const int threadCount, PerftTable &table) {
+    if(depth <= 1) {
+        Board copy = board;
+        return perft(copy, depth);
+    }
+    std::array<Move, 194> moves;
+    std::vector<uint64_t> counts;
+    dividedPerft(board, depth, threadCount, table, moves, counts);
+    return std::accumulate(counts.begin(), counts.end(), uint64_t(0));
+}
+
+inline void printPerftResult(const uint64_t result, const std::chrono::steady_clock::time_point start) {
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
     std::cout << "Result: " << std::to_string(result) << '\n';
-    std::cout << "Time: " << std::to_string((end-start)) << " ms" << '\n';
-    std::cout << "NPS: " << std::to_string(uint64_t(result / ((end-start)/static_cast<double>(1000)))) << '\n';
+    std::cout << "Time: " << std::to_string(elapsed / 1000) << " ms" << '\n';
+    std::cout << "NPS: " << std::to_string(uint64_t(result / (std::max<int64_t>(elapsed, 1) / static_cast<double>(1000000)))) << '\n';
+}
+
+// plain perft on one thread, or with threads and/or a hash table when either is asked for
+inline void runPerftTest(Board &board, const int depth, const int threadCount = 1, const uint64_t hashSize = 0) {
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t result;
+    if(threadCount <= 1 && hashSize == 0) {
+        result = perft(board, depth);
+    } else {
+        PerftTable table(hashSize);
+        result = parallelPerft(board, depth, threadCount, table);
+    }
+    printPerftResult(result, start);
 }
 
 const std::pair<std::string, std::vector<int>> perftSuite[] = {
@@ -120,13 +242,36 @@ const std::array<std::string, 20> benchPositions = {
     "6o/4o2/1o-1-2/7/2-1-2/3xx2/7 x 4 5"
 };
 
-inline void runPerftSuite() {
-    int j = 0;
+// runs every position of the suite, with the positions split between threads
+// the results are printed in order once everything is done
+inline void runPerftSuite(const int threadCount = 1) {
+    std::vector<std::pair<const std::string*, const std::vector<int>*>> positions;
     for(const auto& [fen, nodes] : perftSuite) {
-        Board board(fen);
+        positions.emplace_back(&fen, &nodes);
+    }
+    std::vector<std::vector<int>> results(positions.size());
+    std::atomic<size_t> nextPosition = 0;
+    std::vector<std::thread> threads;
+    for(int i = 0; i < std::max(threadCount, 1); i++) {
+        threads.emplace_back([&]() {
+            for(size_t position = nextPosition++; position < positions.size(); position = nextPosition++) {
+                Board board(*positions[position].first);
+                for(unsigned int depth = 0; depth < positions[position].second->size(); depth++) {
+                    results[position].push_back(perft(board, depth));
+                }
+            }
+        });
+    }
+    for(auto &thread : threads) {
+        thread.join();
+    }
+    int j = 0;
+    for(size_t position = 0; position < positions.size(); position++) {
+        const std::string &fen = *positions[position].first;
+        const std::vector<int> &nodes = *positions[position].second;
         for(unsigned int i = 0; i < nodes.size(); ++i) {
             j++;
-            int result = perft(board, i);
+            const int result = results[position][i];
             if(result == nodes[i]) {
                 std::cout << "Passed test number " << j << std::endl;
             } else {
@@ -136,20 +281,15 @@ inline void runPerftSuite() {
     }
 }
 
-inline void runSplitPerft(Board board, const int depth) {
-    clock_t start = clock();
+// perft with the count under every root move printed, split between threads and hashed the same way as perft
+inline void runSplitPerft(const Board &board, const int depth, const int threadCount = 1, const uint64_t hashSize = 0) {
+    const auto start = std::chrono::steady_clock::now();
+    PerftTable table(hashSize);
     std::array<Move, 194> moves;
-    const int numMoves = board.getMoves(moves);
-    uint64_t result = 0;
+    std::vector<uint64_t> counts;
+    const int numMoves = dividedPerft(board, std::max(depth, 1), threadCount, table, moves, counts);
     for(int i = 0; i < numMoves; i++) {
-        board.makeMove(moves[i]);
-        const uint64_t currentResult = perft(board, depth - 1);
-        result += currentResult;
-        std::cout << moves[i].toLongAlgebraic() << ": " << currentResult << std::endl;
-        board.undoMove();
+        std::cout << moves[i].toLongAlgebraic() << ": " << counts[i] << std::endl;
     }
-    clock_t end = clock();
-    std::cout << "Result: " << std::to_string(result) << '\n';
-    std::cout << "Time: " << std::to_string((end-start)) << " ms" << '\n';
-    std::cout << "NPS: " << std::to_string(uint64_t(result / ((end-start)/static_cast<double>(1000)))) << '\n';
-}
\ No newline at end of file
+    printPerftResult(std::accumulate(counts.begin(), counts.end(), uint64_t(0)), start);
+}
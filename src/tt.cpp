@@ -0,0 +1,246 @@
+/*
+    Anthraxx
+    Copyright (C) 2024 Joseph Pasfield
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "global_includes.h"
+#include "tt.h"
+#include "board.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// big tables are allocated in huge page sized chunks, so the os can back them with huge pages
+constexpr uint64_t hugePageSize = 2 * 1024 * 1024;
+
+// "ANTHXXTT", and the version is bumped whenever the layout of the entries changes
+constexpr uint64_t ttFileMagic = 0x54545858'48544e41;
+constexpr uint32_t ttFileVersion = 2;
+
+namespace {
+    void *allocateTable(const uint64_t bytes) {
+#ifdef _WIN32
+        return _aligned_malloc(bytes, hugePageSize);
+#else
+        void *memory = std::aligned_alloc(hugePageSize, bytes);
+#ifdef MADV_HUGEPAGE
+        if(memory != nullptr) madvise(memory, bytes, MADV_HUGEPAGE);
+#endif
+        return memory;
+#endif
+    }
+
+    void freeTable(void *memory) {
+#ifdef _WIN32
+        _aligned_free(memory);
+#else
+        std::free(memory);
+#endif
+    }
+}
+
+TT::~TT() {
+    release();
+}
+
+// resizes the table, in megabytes, to any size
+// a hash file is never resized, remaking it at another size would throw away everything in it
+void TT::resize(uint64_t newSizeMB) {
+    if(isMapped()) {
+        std::cout << "info string Hash doesn't resize a hash file, it keeps the size it was made with, use a new file to change it" << std::endl;
+        return;
+    }
+    allocate(std::max<uint64_t>(newSizeMB, 1) * 1024 * 1024 / sizeof(Bucket));
+    clearTable();
+}
+
+// makes room for a number of buckets on the heap, the contents are left undefined
+void TT::allocate(const uint64_t newBucketCount) {
+    // round the allocation up to whole huge pages, aligned_alloc needs a multiple of the alignment anyways
+    const uint64_t newAllocatedBytes = (newBucketCount * sizeof(Bucket) + hugePageSize - 1) / hugePageSize * hugePageSize;
+    if(isMapped() || newAllocatedBytes != allocatedBytes) {
+        release();
+        table = static_cast<Bucket*>(allocateTable(newAllocatedBytes));
+        if(table == nullptr) {
+            std::cout << "info string failed to allocate " << newAllocatedBytes / (1024 * 1024) << " MB for the transposition table" << std::endl;
+            // fall back to the default size so that the engine can still play
+            const uint64_t defaultBuckets = defaultSize * 1024 * 1024 / sizeof(Bucket);
+            if(newBucketCount != defaultBuckets) allocate(defaultBuckets);
+            return;
+        }
+        allocatedBytes = newAllocatedBytes;
+    }
+    bucketCount = newBucketCount;
+}
+
+// frees the table, whether it's on the heap or in a file
+void TT::release() {
+#ifndef _WIN32
+    if(isMapped()) {
+        munmap(mapping, mappingBytes);
+        mapping = nullptr;
+        mappingBytes = 0;
+        table = nullptr;
+        return;
+    }
+#endif
+    freeTable(table);
+    table = nullptr;
+    allocatedBytes = 0;
+}
+
+// clears the table, split across the threads so that big tables don't stall for long
+void TT::clearTable() {
+    age = 0;
+    if(isMapped()) mapping->age = age;
+    const uint64_t threadCount = std::clamp<uint64_t>(threads, 1, std::max<uint64_t>(bucketCount / 1024, 1));
+    const uint64_t chunkSize = (bucketCount + threadCount - 1) / threadCount;
+    std::vector<std::thread> clearThreads;
+    for(uint64_t i = 1; i < threadCount; i++) {
+        clearThreads.emplace_back([this, i, chunkSize]() {
+            const uint64_t start = std::min(i * chunkSize, bucketCount);
+            const uint64_t end = std::min(start + chunkSize, bucketCount);
+            std::fill(table + start, table + end, Bucket());
+        });
+    }
+    std::fill(table, table + std::min(chunkSize, bucketCount), Bucket());
+    for(auto &thread : clearThreads) {
+        thread.join();
+    }
+}
+
+TTFileHeader TT::makeHeader() const {
+    TTFileHeader header{};
+    header.magic = ttFileMagic;
+    header.version = ttFileVersion;
+    header.bucketSize = sizeof(Bucket);
+    header.zobristSignature = zobristSignature();
+    header.bucketCount = bucketCount;
+    header.age = age;
+    return header;
+}
+
+bool TT::validHeader(const TTFileHeader &header) const {
+    return header.magic == ttFileMagic
+        && header.version == ttFileVersion
+        && header.bucketSize == sizeof(Bucket)
+        && header.zobristSignature == zobristSignature();
+}
+
+// dumps the table to a file, so that it can be loaded again after a restart
+bool TT::save(const std::string &path) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if(!file) return false;
+    const TTFileHeader header = makeHeader();
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(table), std::streamsize(bucketCount * sizeof(Bucket)));
+    return bool(file);
+}
+
+// loads a table written by save(), the table takes on the size of the file
+bool TT::load(const std::string &path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    const uint64_t fileSize = file ? uint64_t(file.tellg()) : 0;
+    file.seekg(0);
+    TTFileHeader header;
+    if(!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || !validHeader(header)) return false;
+    // a truncated or corrupt header mustn't get as far as allocating, that would throw away the current table
+    if(header.bucketCount == 0 || header.bucketCount != (fileSize - sizeof(header)) / sizeof(Bucket)
+            || sizeof(header) + header.bucketCount * sizeof(Bucket) != fileSize) return false;
+    if(header.bucketCount != bucketCount) {
+        // a mapped table keeps the size of its own file
+        if(isMapped()) return false;
+        allocate(header.bucketCount);
+        // allocate fell back to the default size, which leaves the new memory undefined
+        if(bucketCount != header.bucketCount) {
+            clearTable();
+            return false;
+        }
+    }
+    if(!file.read(reinterpret_cast<char*>(table), std::streamsize(bucketCount * sizeof(Bucket)))) {
+        clearTable();
+        return false;
+    }
+    age = header.age;
+    if(isMapped()) mapping->age = age;
+    return true;
+}
+
+// keeps the table in a memory mapped file that outlives the process and can be shared by several engines
+// an existing file made with the same zobrist keys is reused at whatever size it was made with,
+// otherwise the file is made at the current Hash size and starts out empty
+// an empty path moves the table back onto the heap
+bool TT::mapFile(const std::string &path) {
+#ifdef _WIN32
+    if(!path.empty()) {
+        std::cout << "info string memory mapped hash files are not supported on windows" << std::endl;
+        return false;
+    }
+#else
+    if(!path.empty()) {
+        const int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        struct stat fileStats;
+        if(fd >= 0 && fstat(fd, &fileStats) == 0) {
+            const uint64_t fileSize = fileStats.st_size;
+            TTFileHeader header;
+            const bool reused = fileSize > sizeof(header)
+                && pread(fd, &header, sizeof(header), 0) == ssize_t(sizeof(header))
+                && validHeader(header)
+                && (fileSize - sizeof(header)) % sizeof(Bucket) == 0
+                && header.bucketCount == (fileSize - sizeof(header)) / sizeof(Bucket);
+            const uint64_t buckets = reused ? header.bucketCount : bucketCount;
+            const uint64_t bytes = sizeof(TTFileHeader) + buckets * sizeof(Bucket);
+            if(reused || ftruncate(fd, off_t(bytes)) == 0) {
+                void *memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if(memory != MAP_FAILED) {
+                    release();
+                    mapping = static_cast<TTFileHeader*>(memory);
+                    mappingBytes = bytes;
+                    mappedPath = path;
+                    table = reinterpret_cast<Bucket*>(mapping + 1);
+                    bucketCount = buckets;
+                    close(fd);
+                    if(reused) {
+                        age = mapping->age;
+                        std::cout << "info string reusing hash file " << path << " at " << getSizeMB() << " MB" << std::endl;
+                    } else {
+                        *mapping = makeHeader();
+                        clearTable();
+                    }
+                    return true;
+                }
+                // the old mapping of this file is still in use, so it can't be left shorter than that mapping
+                if(!reused && isMapped() && path == mappedPath) ftruncate(fd, off_t(mappingBytes));
+            }
+        }
+        if(fd >= 0) close(fd);
+        std::cout << "info string failed to map hash file " << path << std::endl;
+        return false;
+    }
+#endif
+    if(isMapped()) {
+        mappedPath.clear();
+        allocate(bucketCount);
+        clearTable();
+    }
+    return true;
+}
@@ -23,59 +23,153 @@ enum flags {
     Undefined, FailLow, BetaCutoff, Exact
 };
 
+// 12 bytes, 5 of them fit in a cache line
 struct Transposition {
-    uint64_t zobristKey;
-    int score;
+    // the lower 32 bits of the zobrist hash, the upper bits are already used to find the bucket
+    uint32_t key;
+    int32_t score;
     Move bestMove;
-    uint8_t flag;
     uint8_t depth;
+    // the flag is in the bottom 2 bits, the age of the search that wrote it is in the top 6
+    uint8_t flagAndAge;
     Transposition() {
-        zobristKey = 0;
-        bestMove = Move();
-        flag = 0;
+        key = 0;
         score = 0;
+        bestMove = Move();
         depth = 0;
+        flagAndAge = Undefined;
+    }
+    bool matches(const uint64_t hash) const {
+        return key == uint32_t(hash);
     }
-    Transposition(uint64_t _zobristKey, Move _bestMove, uint8_t _flag, int _score, uint8_t _depth) {
-        zobristKey = _zobristKey;
-        bestMove = _bestMove;
-        flag = _flag;
-        score = _score;
-        depth = _depth;
+    int getFlag() const {
+        return flagAndAge & 0b11;
+    }
+    int getAge() const {
+        return flagAndAge >> 2;
     }
 };
 
-constexpr int defaultSize = 64;
+constexpr int entriesPerBucket = 5;
+constexpr int maxAge = 64;
+
+// one cache line, so a probe only ever touches one line of memory
+struct alignas(64) Bucket {
+    std::array<Transposition, entriesPerBucket> entries;
+};
+
+static_assert(sizeof(Transposition) == 12);
+static_assert(sizeof(Bucket) == 64);
+
+constexpr uint64_t defaultSize = 64;
+
+// sits in front of the buckets in saved and memory mapped tables, so stale or foreign files can be rejected
+struct alignas(64) TTFileHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t bucketSize;
+    // tables made with different zobrist keys are useless, so files are tied to the keys that made them
+    uint64_t zobristSignature;
+    uint64_t bucketCount;
+    uint8_t age;
+};
+
+static_assert(sizeof(TTFileHeader) == 64);
 
 struct TT {
     public:
         TT() {
             resize(defaultSize);
-            clearTable();
         }
-        TT(int newSize) {
-            resize(newSize);
-            clearTable();
+        TT(uint64_t newSizeMB) {
+            resize(newSizeMB);
         }
+        ~TT();
+        TT(const TT&) = delete;
+        TT& operator=(const TT&) = delete;
+        // returns the entry for this position if there is one, otherwise the entry that should be replaced
         Transposition* getEntry(uint64_t hash) {
-            return &table[hash & mask];
+            Bucket &bucket = table[index(hash)];
+            Transposition *replace = &bucket.entries[0];
+            int worstQuality = bigNumber;
+            for(auto &entry : bucket.entries) {
+                if(entry.matches(hash) && entry.getFlag() != Undefined) {
+                    return &entry;
+                }
+                // prefer replacing shallow entries, and entries from old searches
+                const int quality = entry.depth - 8 * ((maxAge + age - entry.getAge()) % maxAge);
+                if(quality < worstQuality) {
+                    worstQuality = quality;
+                    replace = &entry;
+                }
+            }
+            return replace;
+        }
+        // starts loading the bucket for a position into cache, ahead of getEntry
+        void prefetch(uint64_t hash) const {
+            __builtin_prefetch(&table[index(hash)]);
+        }
+        // writes to an entry returned by getEntry, deep results for the same position are only replaced by similarly deep ones
+        void pushEntry(Transposition *entry, uint64_t hash, Move bestMove, int flag, int score, int depth) {
+            const bool samePosition = entry->matches(hash) && entry->getFlag() != Undefined;
+            // don't overwrite a move with a null move
+            if(bestMove == Move() && samePosition) bestMove = entry->bestMove;
+            if(!samePosition || flag == Exact || depth + 2 >= entry->depth || entry->getAge() != age) {
+                entry->key = uint32_t(hash);
+                entry->score = score;
+                entry->bestMove = bestMove;
+                entry->depth = depth;
+                entry->flagAndAge = flag | (age << 2);
+            } else {
+                entry->bestMove = bestMove;
+            }
         }
-        void pushEntry(Transposition entry, uint64_t hash) {
-            table[hash & mask] = entry;
+        // called at the start of every search, so entries from previous searches get replaced first
+        void newSearch() {
+            age = (age + 1) % maxAge;
+            if(mapping != nullptr) mapping->age = age;
         }
-        void clearTable() {
-            std::fill(table.begin(), table.end(), Transposition());
+        // the size in megabytes, rounded up since resize rounds the bucket count down
+        uint64_t getSizeMB() const {
+            return (bucketCount * sizeof(Bucket) + 1024 * 1024 - 1) / (1024 * 1024);
         }
-        void resize(int newSize) {
-            int newSizeMB = newSize;
-            int newSizeB = newSizeMB * 1024 * 1024;
-            int entrySizeB = sizeof(Transposition);
-            int newSizeEntries = newSizeB / entrySizeB;
-            mask = newSizeEntries - 1;
-            table.resize(newSizeEntries, Transposition());
-            clearTable();
+        // permill of the sampled entries that were written during the current search
+        int hashfull() const {
+            int used = 0;
+            for(int i = 0; i < 200; i++) {
+                for(const auto &entry : table[i].entries) {
+                    used += entry.getFlag() != Undefined && entry.getAge() == age;
+                }
+            }
+            return used;
+        }
+        void clearTable();
+        void resize(uint64_t newSizeMB);
+        bool save(const std::string &path) const;
+        bool load(const std::string &path);
+        bool mapFile(const std::string &path);
+        bool isMapped() const {
+            return mapping != nullptr;
+        }
+        void setThreads(const int threadCount) {
+            threads = threadCount;
         }
-        uint64_t mask;
     private:
-        std::vector<Transposition> table;
-};
\ No newline at end of file
+        Bucket *table = nullptr;
+        uint64_t bucketCount = 0;
+        uint64_t allocatedBytes = 0;
+        // set when the table lives in a memory mapped file instead of the heap
+        TTFileHeader *mapping = nullptr;
+        uint64_t mappingBytes = 0;
+        std::string mappedPath;
+        void allocate(const uint64_t newBucketCount);
+        void release();
+        TTFileHeader makeHeader() const;
+        bool validHeader(const TTFileHeader &header) const;
+        int threads = 1;
+        uint8_t age = 0;
+        // maps the hash onto [0, bucketCount) with a multiply and a shift, so any table size works
+        uint64_t index(const uint64_t hash) const {
+            return static_cast<uint64_t>((static_cast<unsigned __int128>(hash) * bucketCount) >> 64);
+        }
+};
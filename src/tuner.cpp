@@ -0,0 +1,249 @@
+/*
+    Anthraxx
+    Copyright (C) 2024 Joseph Pasfield
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "tuner.h"
+#include "board.h"
+#include "eval.h"
+
+/*
+    Texel tuning for the hand crafted evaluation
+    the data file has one position per line, a fen followed by the result from x's point of view, for example
+    x5o/7/7/7/7/7/o5x x 0 1 [0.5]
+    results can be written as 1.0/0.5/0.0, 1-0/1/2-1/2/0-1, with or without brackets or a | before them
+    the evaluation is linear in its weights, so every position is boiled down to its term counts once at load time
+*/
+
+namespace {
+    // term counts from x's point of view, and the result of the game
+    struct TuningPosition {
+        std::array<int16_t, TermCount> features;
+        float result;
+    };
+
+    bool parseResult(std::string text, float &result) {
+        std::erase_if(text, [](char c) { return c == '[' || c == ']' || c == '"' || c == ';'; });
+        if(text == "1-0") text = "1.0";
+        if(text == "0-1") text = "0.0";
+        if(text == "1/2-1/2") text = "0.5";
+        try {
+            result = std::stof(text);
+        } catch(...) {
+            return false;
+        }
+        return result >= 0 && result <= 1;
+    }
+
+    // the board part of a fen has to cover exactly 49 squares, the board constructor takes it on trust
+    bool validBoard(const std::string &text) {
+        const std::vector<std::string> ranks = split(text, '/');
+        if(ranks.size() != 7) return false;
+        for(const std::string &rank : ranks) {
+            int squares = 0;
+            for(const char c : rank) {
+                if(c == 'x' || c == 'o' || c == '-') {
+                    squares++;
+                } else if(c >= '1' && c <= '7') {
+                    squares += c - '0';
+                } else {
+                    return false;
+                }
+            }
+            if(squares != 7) return false;
+        }
+        return true;
+    }
+
+    // checks everything the board constructor would choke on, the counters go through stoi there
+    bool validLine(const std::vector<std::string> &bits, TuningPosition &position) {
+        if(bits.size() < 5 || !validBoard(bits[0]) || (bits[1] != "x" && bits[1] != "o")) return false;
+        try {
+            std::stoi(bits[2]);
+            std::stoi(bits[3]);
+        } catch(...) {
+            return false;
+        }
+        return parseResult(bits.back(), position.result);
+    }
+
+    std::vector<TuningPosition> loadPositions(const std::string &path) {
+        std::vector<TuningPosition> positions;
+        std::ifstream file(path);
+        std::string line;
+        int lineNumber = 0;
+        int skipped = 0;
+        while(std::getline(file, line)) {
+            lineNumber++;
+            std::erase(line, '|');
+            std::erase(line, '\r');
+            std::vector<std::string> bits = split(line, ' ');
+            std::erase(bits, "");
+            if(bits.empty()) continue;
+            TuningPosition position;
+            if(!validLine(bits, position)) {
+                // only the first few are shown, a whole file in the wrong format would flood the output
+                if(skipped++ < 10) std::cout << "info string skipping malformed line " << lineNumber << ": " << line << std::endl;
+                continue;
+            }
+            const Board board(bits[0] + " " + bits[1] + " " + bits[2] + " " + bits[3]);
+            const EvalFeatures features = getEvalFeatures(board);
+            const int sign = (board.getColorToMove() == X ? 1 : -1);
+            for(int i = 0; i < TermCount; i++) {
+                position.features[i] = sign * features[i];
+            }
+            positions.push_back(position);
+        }
+        if(skipped > 0) std::cout << "info string skipped " << skipped << " malformed lines" << std::endl;
+        return positions;
+    }
+
+    double sigmoid(const double eval, const double k) {
+        return 1.0 / (1.0 + std::exp(-k * eval / 400.0));
+    }
+
+    double evaluate(const TuningPosition &position, const std::array<double, TermCount> &params) {
+        double eval = 0;
+        for(int i = 0; i < TermCount; i++) {
+            eval += position.features[i] * params[i];
+        }
+        return eval;
+    }
+
+    // runs a function over every slice of the positions at once, one thread per slice
+    template <typename Function>
+    void forEachSlice(const std::vector<TuningPosition> &positions, const int threadCount, Function function) {
+        std::vector<std::thread> threads;
+        assert(threadCount > 0);
+        const size_t sliceSize = (positions.size() + threadCount - 1) / threadCount;
+        for(int i = 0; i < threadCount; i++) {
+            const size_t start = std::min(positions.size(), i * sliceSize);
+            const size_t end = std::min(positions.size(), start + sliceSize);
+            threads.emplace_back(function, i, start, end);
+        }
+        for(auto &thread : threads) {
+            thread.join();
+        }
+    }
+
+    // mean squared error between the results and the predictions
+    double getError(const std::vector<TuningPosition> &positions, const std::array<double, TermCount> &params, const double k, const int threadCount) {
+        std::vector<double> errors(threadCount);
+        forEachSlice(positions, threadCount, [&](const int thread, const size_t start, const size_t end) {
+            double error = 0;
+            for(size_t i = start; i < end; i++) {
+                const double difference = positions[i].result - sigmoid(evaluate(positions[i], params), k);
+                error += difference * difference;
+            }
+            errors[thread] = error;
+        });
+        return std::accumulate(errors.begin(), errors.end(), 0.0) / positions.size();
+    }
+
+    // gradient of the error with respect to each weight
+    std::array<double, TermCount> getGradient(const std::vector<TuningPosition> &positions, const std::array<double, TermCount> &params, const double k, const int threadCount) {
+        std::vector<std::array<double, TermCount>> gradients(threadCount);
+        forEachSlice(positions, threadCount, [&](const int thread, const size_t start, const size_t end) {
+            std::array<double, TermCount> gradient = {};
+            for(size_t i = start; i < end; i++) {
+                const double prediction = sigmoid(evaluate(positions[i], params), k);
+                const double factor = (prediction - positions[i].result) * prediction * (1 - prediction);
+                for(int j = 0; j < TermCount; j++) {
+                    gradient[j] += factor * positions[i].features[j];
+                }
+            }
+            gradients[thread] = gradient;
+        });
+        std::array<double, TermCount> total = {};
+        for(const auto &gradient : gradients) {
+            for(int j = 0; j < TermCount; j++) {
+                total[j] += gradient[j] * 2.0 * k / 400.0 / positions.size();
+            }
+        }
+        return total;
+    }
+
+    // finds the sigmoid scale that fits the current weights best, by narrowing down a range of them
+    double findK(const std::vector<TuningPosition> &positions, const std::array<double, TermCount> &params, const int threadCount) {
+        double low = 0.0;
+        double high = 10.0;
+        for(int i = 0; i < 40; i++) {
+            const double third = (high - low) / 3;
+            if(getError(positions, params, low + third, threadCount) < getError(positions, params, high - third, threadCount)) {
+                high -= third;
+            } else {
+                low += third;
+            }
+        }
+        return (low + high) / 2;
+    }
+
+    void printParams(const std::array<double, TermCount> &params) {
+        for(int i = 0; i < TermCount; i++) {
+            std::cout << termNames[i] << ": " << std::lround(params[i]) << (i + 1 < TermCount ? ", " : "\n");
+        }
+    }
+}
+
+// tunes the hand crafted evaluation weights with adam, and uses the result from then on
+void runTuner(const std::string &path, const int epochs, const int threadCount) {
+    const auto begin = std::chrono::steady_clock::now();
+    const std::vector<TuningPosition> positions = loadPositions(path);
+    if(positions.empty()) {
+        std::cout << "no positions loaded from " << path << std::endl;
+        return;
+    }
+    std::cout << "loaded " << positions.size() << " positions" << std::endl;
+
+    std::array<double, TermCount> params;
+    for(int i = 0; i < TermCount; i++) {
+        params[i] = evalParams[i];
+    }
+    const double k = findK(positions, params, threadCount);
+    std::cout << "k: " << k << ", starting error: " << getError(positions, params, k, threadCount) << std::endl;
+
+    constexpr double learningRate = 1.0;
+    constexpr double beta1 = 0.9;
+    constexpr double beta2 = 0.999;
+    constexpr double epsilon = 1e-8;
+    std::array<double, TermCount> momentum = {};
+    std::array<double, TermCount> velocity = {};
+    for(int epoch = 1; epoch <= epochs; epoch++) {
+        const std::array<double, TermCount> gradient = getGradient(positions, params, k, threadCount);
+        for(int i = 0; i < TermCount; i++) {
+            momentum[i] = beta1 * momentum[i] + (1 - beta1) * gradient[i];
+            velocity[i] = beta2 * velocity[i] + (1 - beta2) * gradient[i] * gradient[i];
+            const double correctedMomentum = momentum[i] / (1 - std::pow(beta1, epoch));
+            const double correctedVelocity = velocity[i] / (1 - std::pow(beta2, epoch));
+            params[i] -= learningRate * correctedMomentum / (std::sqrt(correctedVelocity) + epsilon);
+        }
+        if(epoch % 100 == 0 || epoch == epochs) {
+            std::cout << "epoch " << epoch << " error " << getError(positions, params, k, threadCount) << std::endl;
+            printParams(params);
+        }
+    }
+
+    for(int i = 0; i < TermCount; i++) {
+        evalParams[i] = std::lround(params[i]);
+    }
+    const auto elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << "tuning finished in " << elapsedTime << " ms" << std::endl;
+    if(useNNUE) {
+        std::cout << "info string eval: nnue, the new weights only take effect with UseNNUE off" << std::endl;
+    } else {
+        std::cout << "info string eval: hand crafted, the new weights are in use" << std::endl;
+    }
+}
@@ -20,28 +20,220 @@
 #include "tests.h"
 #include "search.h"
 #include "tt.h"
+#include "eval.h"
+#include "tuner.h"
 
 TT tt;
-Engine engine(&tt);
+EvalCache evalCache;
+Engine engine(&tt, &evalCache);
 Board board("x5o/7/7/7/7/7/o5x x 0 1");
+// searches run here so that the main thread can keep reading commands
+std::thread searchThread;
+
+// waits for the current search to finish, if there is one
+void waitForSearch() {
+    if(searchThread.joinable()) searchThread.join();
+}
+
+// starts a search on its own thread
+void startSearch(const int softTimeLimit, const int hardTimeLimit, const int depth, const bool infinite, const bool ponder) {
+    waitForSearch();
+    engine.prepareSearch(ponder);
+    searchThread = std::thread([=, searchBoard = board]() mutable {
+        engine.think(searchBoard, softTimeLimit, hardTimeLimit, depth, true, infinite);
+    });
+}
+
+// forgets everything the engine learned from previous searches
+void clearSearchState() {
+    engine.newGame();
+    // a file backed table is there to be kept between games and restarts
+    if(!tt.isMapped()) tt.clearTable();
+    evalCache.clear();
+}
 
 // resets everything
 void newGame() {
-    //engine.newGame();
+    clearSearchState();
     board = Board("x5o/7/7/7/7/7/o5x x 0 1");
-    tt.clearTable();
 }
 
-void runBench(int depth = 7) {
-    int total = 0;
-    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
-    for(const std::string &fen : benchPositions) {
-        newGame();
-        Board board(fen);
-        total += engine.benchSearch(board, depth);
+struct BenchSettings {
+    int depth = 7;
+    // 0 leaves the threads and hash as they are
+    int threads = 0;
+    uint64_t hash = 0;
+    int repetitions = 1;
+    std::string file;
+    bool json = false;
+};
+
+// bench <depth> <threads> like before, or any of: depth <d> threads <n> hash <mb> reps <r> file <path> json
+BenchSettings parseBenchSettings(const std::vector<std::string> &bits) {
+    BenchSettings settings;
+    for(size_t i = 1; i < bits.size(); i++) {
+        const std::string &token = bits[i];
+        const bool hasValue = i + 1 < bits.size();
+        if(token == "json") {
+            settings.json = true;
+        } else if(token == "depth" && hasValue) {
+            settings.depth = std::stoi(bits[++i]);
+        } else if(token == "threads" && hasValue) {
+            settings.threads = std::stoi(bits[++i]);
+        } else if(token == "hash" && hasValue) {
+            settings.hash = std::stoull(bits[++i]);
+        } else if(token == "reps" && hasValue) {
+            settings.repetitions = std::max(std::stoi(bits[++i]), 1);
+        } else if(token == "file" && hasValue) {
+            settings.file = bits[++i];
+        } else if(i == 1 && std::isdigit(token[0])) {
+            settings.depth = std::stoi(token);
+        } else if(i == 2 && std::isdigit(token[0])) {
+            settings.threads = std::stoi(token);
+        }
+    }
+    settings.depth = std::clamp(settings.depth, 1, maxPly - 1);
+    return settings;
+}
+
+// the fens from a file, one per line, or the built in positions
+std::vector<std::string> getBenchPositions(const std::string &file) {
+    if(file.empty()) return std::vector<std::string>(benchPositions.begin(), benchPositions.end());
+    std::vector<std::string> positions;
+    std::ifstream input(file);
+    std::string line;
+    while(std::getline(input, line)) {
+        if(!line.empty() && line.back() == '\r') line.pop_back();
+        if(!line.empty()) positions.push_back(line);
+    }
+    return positions;
+}
+
+// sample mean and standard deviation
+std::pair<double, double> meanAndDeviation(const std::vector<double> &values) {
+    const double mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+    if(values.size() < 2) return {mean, 0.0};
+    double squares = 0;
+    for(const double value : values) {
+        squares += (value - mean) * (value - mean);
+    }
+    return {mean, std::sqrt(squares / (values.size() - 1))};
+}
+
+template <typename T>
+std::string jsonArray(const std::vector<T> &values) {
+    std::string result = "[";
+    for(size_t i = 0; i < values.size(); i++) {
+        if(i > 0) result += ",";
+        result += std::to_string(values[i]);
+    }
+    return result + "]";
+}
+
+// quotes a string for json, escaping anything that would end it early
+std::string jsonString(const std::string &text) {
+    std::string result = "\"";
+    for(const char character : text) {
+        if(character == '"' || character == '\\') {
+            result += '\\';
+            result += character;
+        } else if(static_cast<unsigned char>(character) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", character);
+            result += escaped;
+        } else {
+            result += character;
+        }
     }
-    const auto elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
-    std::cout << total << " nodes " << std::to_string(int(total / (double(elapsedTime) / 1000))) << " nps" << std::endl;
+    return result + "\"";
+}
+
+// searches every position to a fixed depth, the search state is cleared before each one so runs are reproducible
+// bench has its own engine and heap table, so the Threads and Hash options and any hash file are left as they were
+// the last line of the text output stays "<nodes> nodes <nps> nps" for tools that read it
+void runBench(const BenchSettings &settings) {
+    const int threads = std::clamp(settings.threads > 0 ? settings.threads : engine.getThreadCount(), 1, 256);
+    TT benchTable(settings.hash > 0 ? settings.hash : tt.getSizeMB());
+    benchTable.setThreads(threads);
+    auto benchEngine = std::make_unique<Engine>(&benchTable, &evalCache);
+    benchEngine->setThreads(threads);
+    const std::vector<std::string> positions = getBenchPositions(settings.file);
+    if(positions.empty()) {
+        std::cout << "info string no bench positions" << std::endl;
+        return;
+    }
+
+    // results[position][repetition]
+    std::vector<std::vector<BenchResult>> results(positions.size());
+    std::vector<double> totalTimes;
+    std::vector<double> totalNps;
+    uint64_t evalCacheHits = 0;
+    uint64_t evalCacheProbes = 0;
+    uint64_t totalNodes = 0;
+    for(int repetition = 0; repetition < settings.repetitions; repetition++) {
+        totalNodes = 0;
+        int64_t totalTime = 0;
+        for(size_t i = 0; i < positions.size(); i++) {
+            benchEngine->newGame();
+            benchTable.clearTable();
+            evalCache.clear();
+            Board benchBoard(positions[i]);
+            results[i].push_back(benchEngine->benchSearch(benchBoard, settings.depth));
+            totalNodes += results[i].back().nodes;
+            totalTime += results[i].back().microseconds;
+            uint64_t hits, probes;
+            benchEngine->getEvalCacheStats(hits, probes);
+            evalCacheHits += hits;
+            evalCacheProbes += probes;
+        }
+        totalTimes.push_back(totalTime);
+        totalNps.push_back(totalNodes / (std::max<int64_t>(totalTime, 1) / 1000000.0));
+    }
+    const auto [meanTime, timeDeviation] = meanAndDeviation(totalTimes);
+    const auto [meanNps, npsDeviation] = meanAndDeviation(totalNps);
+
+    if(settings.json) {
+        std::cout << "{\"version\":" << jsonString(Version) << ",\"depth\":" << settings.depth << ",\"threads\":" << threads
+            << ",\"hash\":" << benchTable.getSizeMB() << ",\"repetitions\":" << settings.repetitions << ",\"positions\":[";
+        for(size_t i = 0; i < positions.size(); i++) {
+            std::vector<uint64_t> nodes;
+            std::vector<int64_t> times;
+            std::string depthTimes = "[";
+            for(size_t repetition = 0; repetition < results[i].size(); repetition++) {
+                nodes.push_back(results[i][repetition].nodes);
+                times.push_back(results[i][repetition].microseconds);
+                if(repetition > 0) depthTimes += ",";
+                depthTimes += jsonArray(results[i][repetition].depthTimes);
+            }
+            std::cout << (i > 0 ? "," : "") << "{\"fen\":" << jsonString(positions[i]) << ",\"nodes\":" << jsonArray(nodes)
+                << ",\"microseconds\":" << jsonArray(times) << ",\"depthMicroseconds\":" << depthTimes << "]}";
+        }
+        std::cout << "],\"nodes\":" << totalNodes << ",\"meanMicroseconds\":" << meanTime << ",\"stdDevMicroseconds\":" << timeDeviation
+            << ",\"meanNps\":" << uint64_t(meanNps) << ",\"stdDevNps\":" << uint64_t(npsDeviation) << "}" << std::endl;
+        return;
+    }
+
+    for(size_t i = 0; i < positions.size(); i++) {
+        std::vector<double> times;
+        for(const BenchResult &result : results[i]) {
+            times.push_back(result.microseconds);
+        }
+        const double meanPositionTime = meanAndDeviation(times).first;
+        std::cout << "position " << i + 1 << " nodes " << results[i][0].nodes << " time " << meanPositionTime / 1000 << " ms"
+            << " nps " << uint64_t(results[i][0].nodes / (std::max(meanPositionTime, 1.0) / 1000000)) << " depth times (ms)";
+        for(const int64_t time : results[i][0].depthTimes) {
+            std::cout << " " << time / 1000.0;
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "time " << meanTime / 1000 << " ms (sd " << timeDeviation / 1000 << ") nps " << uint64_t(meanNps) << " (sd " << uint64_t(npsDeviation)
+        << ") over " << settings.repetitions << " repetitions" << std::endl;
+    if(evalCache.enabled()) {
+        std::cout << "eval cache hits " << evalCacheHits << " of " << evalCacheProbes << " (" << std::to_string(evalCacheProbes == 0 ? 0 : 100 * evalCacheHits / evalCacheProbes) << "%)" << std::endl;
+    } else {
+        std::cout << "eval cache off" << std::endl;
+    }
+    std::cout << totalNodes << " nodes " << std::to_string(uint64_t(meanNps)) << " nps" << std::endl;
 }
 
 // loads a position, either startpos or a fen string
@@ -65,7 +257,16 @@ void loadPosition(const std::vector<std::string>& bits) {
 void identify() {
     std::cout << "id name Claritaxx " << Version << '\n';
     std::cout << "id author Vast\n";
-    std::cout << "option name Hash type spin default 64 min 1 max 2048" << std::endl;
+    std::cout << "option name Hash type spin default 64 min 1 max 1048576" << std::endl;
+    std::cout << "option name Threads type spin default 1 min 1 max 256" << std::endl;
+    std::cout << "option name Ponder type check default false" << std::endl;
+    std::cout << "option name HashFile type string default <empty>" << std::endl;
+    std::cout << "option name CanonicalHash type check default false" << std::endl;
+    std::cout << "option name EvalCache type spin default 0 min 0 max 1024" << std::endl;
+    std::cout << "option name UseNNUE type check default false" << std::endl;
+    std::cout << "option name LMR type check default true" << std::endl;
+    std::cout << "option name NullMovePruning type check default true" << std::endl;
+    std::cout << "option name ReverseFutility type check default true" << std::endl;
     std::cout << "uaiok" << std::endl;
 }
 
@@ -75,7 +276,18 @@ void go(const std::vector<std::string> &bits) {
     int inc = 0;
     int movestogo = 20;
     int depth = 0;
-    for(int i = 1; i < std::ssize(bits); i+=2) {
+    bool infinite = false;
+    bool ponder = false;
+    for(int i = 1; i < std::ssize(bits); i++) {
+        if(bits[i] == "infinite") {
+            infinite = true;
+            continue;
+        }
+        if(bits[i] == "ponder") {
+            ponder = true;
+            continue;
+        }
+        if(i + 1 >= std::ssize(bits)) break;
         if(bits[i] == "wtime" && board.getColorToMove() == 1) {
             time = std::stoi(bits[i+1]);
         }
@@ -92,31 +304,54 @@ void go(const std::vector<std::string> &bits) {
             depth = std::stoi(bits[i+1]);
         }
     }
-    if(depth != 0) {
-        engine.think(board, bigNumber, bigNumber, depth, true);
+    if(infinite) {
+        startSearch(bigNumber, bigNumber, depth != 0 ? depth : 100, true, ponder);
+    } else if(depth != 0) {
+        startSearch(bigNumber, bigNumber, depth, false, ponder);
     } else if(time != 0) {
         // go wtime x btime x
         // the formulas here are former formulas from Stormphrax, so this means that they are adapted to Chess timing, and may not be the best for Ataxx
         const int softBound = 0.6 * (time / movestogo + inc * 3.0 / 4.0);
         const int hardBound = time / 2;
-        engine.think(board, softBound, hardBound, 100, true);
+        startSearch(softBound, hardBound, 100, false, ponder);
     } else {
         std::cout << "Invalid arguments" << std::endl;
     }
 }
 
-// sets options, though currently just the hash size
-void setOption(const std::vector<std::string>& bits) {
+// sets options
+void setOption(const std::string &command, const std::vector<std::string>& bits) {
     std::string name = bits[2];
     if(name == "Hash") {
-        int newSizeMB = std::stoi(bits[4]);
-        int newSizeB = newSizeMB * 1024 * 1024;
-        // this should be 16 bytes
-        int entrySizeB = sizeof(Transposition);
-        assert(entrySizeB == 16); 
-        int newSizeEntries = newSizeB / entrySizeB;
-        //std::cout << log2(newSizeEntries);
-        tt.resize(newSizeEntries);
+        tt.resize(std::stoull(bits[4]));
+    } else if(name == "HashFile") {
+        // the value is everything after "value", so paths with spaces work
+        std::string path = bits.size() > 4 ? command.substr(command.find(" value ") + 7) : "";
+        if(path == "<empty>") path = "";
+        tt.mapFile(path);
+    } else if(name == "CanonicalHash") {
+        canonicalHashing = bits[4] == "true";
+        // the symmetric hashes weren't being kept up to date
+        board.initializeSymmetries();
+        // an entry under a canonical key is still right for the position that key is the plain hash of, so clearing is only tidiness
+        // a file backed table is kept, the same as on uainewgame
+        if(!tt.isMapped()) tt.clearTable();
+    } else if(name == "EvalCache") {
+        evalCache.resize(std::stoull(bits[4]));
+    } else if(name == "UseNNUE") {
+        useNNUE = bits[4] == "true";
+        evalCache.clear();
+        std::cout << "info string eval: " << (useNNUE ? "nnue" : "hand crafted") << std::endl;
+    } else if(name == "LMR") {
+        useLMR = bits[4] == "true";
+    } else if(name == "NullMovePruning") {
+        useNullMovePruning = bits[4] == "true";
+    } else if(name == "ReverseFutility") {
+        useReverseFutility = bits[4] == "true";
+    } else if(name == "Threads") {
+        const int threads = std::clamp(std::stoi(bits[4]), 1, 256);
+        engine.setThreads(threads);
+        tt.setThreads(threads);
     }
 }
 
@@ -126,18 +361,41 @@ void interpretCommand(const std::string command) {
 
     if(bits.empty()) {
         return;
-    } else if(bits[0] == "position") {
-        loadPosition(bits);
+    } else if(bits[0] == "stop") {
+        engine.stop();
+        return;
     } else if(bits[0] == "isready") {
-        std::cout << "readyok\n";
+        std::cout << "readyok" << std::endl;
+        return;
+    } else if(bits[0] == "ponderhit") {
+        engine.ponderhit();
+        return;
+    }
+
+    // everything else touches state the search is using, so a running search is stopped first
+    // just waiting would deadlock on go infinite or go ponder, the stop that ends those would never be read
+    if(searchThread.joinable()) engine.stop();
+    waitForSearch();
+
+    if(bits[0] == "position") {
+        loadPosition(bits);
     } else if(bits[0] == "uai") {
         identify();
     } else if(bits[0] == "go") {
         go(bits);
-    } else if(bits[0] == "perft") {
-        runPerftTest(board, std::stoi(bits[1]));    
-    } else if(bits[0] == "splitperft") {
-        runSplitPerft(board, std::stoi(bits[1]));
+    } else if((bits[0] == "perft" || bits[0] == "splitperft") && bits.size() > 1) {
+        // perft <depth> [threads <n>] [hash <mb>], and the same for splitperft
+        int threads = 1;
+        uint64_t hash = 0;
+        for(size_t i = 2; i + 1 < bits.size(); i += 2) {
+            if(bits[i] == "threads") threads = std::clamp(std::stoi(bits[i + 1]), 1, 256);
+            if(bits[i] == "hash") hash = std::stoull(bits[i + 1]);
+        }
+        if(bits[0] == "perft") {
+            runPerftTest(board, std::stoi(bits[1]), threads, hash);
+        } else {
+            runSplitPerft(board, std::stoi(bits[1]), threads, hash);
+        }
     } else if(bits[0] == "makemove") {
         board.makeMove(Move(bits[1]));
     } else if(bits[0] == "uainewgame") {
@@ -147,15 +405,22 @@ void interpretCommand(const std::string command) {
     } else if(bits[0] == "getfen") {
         std::cout << board.getFen() << std::endl;  
     } else if(bits[0] == "perftsuite") {
-        runPerftSuite();  
+        // perftsuite [threads]
+        runPerftSuite(bits.size() > 1 ? std::clamp(std::stoi(bits[1]), 1, 256) : 1);
     } else if(bits[0] == "setoption") {
-        setOption(bits);
+        setOption(command, bits);
+    } else if(bits[0] == "savehash" && bits.size() > 1) {
+        std::cout << (tt.save(command.substr(9)) ? "info string saved hash" : "info string failed to save hash") << std::endl;
+    } else if(bits[0] == "loadhash" && bits.size() > 1) {
+        std::cout << (tt.load(command.substr(9)) ? "info string loaded hash" : "info string failed to load hash, it may be from a different version or size") << std::endl;
+    } else if(bits[0] == "tune" && bits.size() > 1) {
+        // tune <datafile> <epochs> <threads>
+        const int epochs = bits.size() > 2 ? std::stoi(bits[2]) : 1000;
+        const int threads = std::clamp(bits.size() > 3 ? std::stoi(bits[3]) : int(std::thread::hardware_concurrency()), 1, 256);
+        runTuner(bits[1], epochs, threads);
+        evalCache.clear();
     } else if(bits[0] == "bench") {
-        if(bits.size() == 1) {
-            runBench();
-        } else {
-            runBench(std::stoi(bits[1]));
-        }
+        runBench(parseBenchSettings(bits));
     } else {
         std::cout << "invalid or unsupported command\n";
     }
@@ -163,16 +428,21 @@ void interpretCommand(const std::string command) {
 
 int main(int argc, char* argv[]) {
     initializeZobrist();
+    initializeNetwork();
+    initializeReductions();
     newGame();
     std::cout << std::boolalpha;
+    // bench from the command line takes the same arguments as the command
     if(argc > 1 && std::string(argv[1]) == "bench") {
-        runBench();
+        runBench(parseBenchSettings(std::vector<std::string>(argv + 1, argv + argc)));
         return 0;
     }
     std::string command;
     while(true) {
         std::getline(std::cin, command, '\n');
-        if(command == "quit") {
+        if(command == "quit" || std::cin.eof()) {
+            engine.stop();
+            waitForSearch();
             return 0;
         }
         interpretCommand(command);
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+# Anthraxx
+# Copyright (C) 2024 Joseph Pasfield
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# writes networks/bootstrap.nnue, the embedded net used until a trained one exists
+# its weights reproduce the old material eval exactly, 100 per tile of difference
+# usage: python3 tools/bootstrap_net.py [output path]
+#
+# the file is the raw little endian int16 weights in the order they appear in Network (src/nnue.h):
+# feature weights [inputSize][hiddenSize], feature biases [hiddenSize], output weights [2][hiddenSize], output bias
+import struct
+import sys
+
+# must match src/nnue.h
+INPUT_SIZE = 98
+HIDDEN_SIZE = 32
+QA = 255
+QB = 64
+EVAL_SCALE = 400
+
+# each own tile adds this much to neuron 0 and each opponent tile to neuron 1
+# 49 tiles stay under QA, so the clipped relu never clips
+TILE_ACTIVATION = 5
+# both perspectives see every tile once, so each of them carries half of the 100 a tile is worth
+# 5 * 408 * 400 / (255 * 64) == 50 exactly
+OUTPUT_WEIGHT = 50 * QA * QB // (TILE_ACTIVATION * EVAL_SCALE)
+assert OUTPUT_WEIGHT * TILE_ACTIVATION * EVAL_SCALE == 50 * QA * QB
+assert 49 * TILE_ACTIVATION <= QA
+
+
+def build():
+    # inputs 0-48 are the perspective's own tiles, 49-97 the opponent's
+    feature_weights = [0] * (INPUT_SIZE * HIDDEN_SIZE)
+    for square in range(49):
+        feature_weights[square * HIDDEN_SIZE + 0] = TILE_ACTIVATION
+        feature_weights[(49 + square) * HIDDEN_SIZE + 1] = TILE_ACTIVATION
+    feature_biases = [0] * HIDDEN_SIZE
+    # side to move: own minus opponent, other side: the same seen from the other end
+    output_weights = [0] * (2 * HIDDEN_SIZE)
+    output_weights[0] = OUTPUT_WEIGHT
+    output_weights[1] = -OUTPUT_WEIGHT
+    output_weights[HIDDEN_SIZE + 0] = -OUTPUT_WEIGHT
+    output_weights[HIDDEN_SIZE + 1] = OUTPUT_WEIGHT
+    output_bias = 0
+    weights = feature_weights + feature_biases + output_weights + [output_bias]
+    return struct.pack('<%dh' % len(weights), *weights)
+
+
+if __name__ == '__main__':
+    path = sys.argv[1] if len(sys.argv) > 1 else 'networks/bootstrap.nnue'
+    data = build()
+    with open(path, 'wb') as file:
+        file.write(data)
+    print('wrote %d bytes to %s' % (len(data), path))
@@ -0,0 +1,302 @@
+/*
+    Anthraxx
+    Copyright (C) 2024 Joseph Pasfield
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+// standalone timings of the board primitives, without the noise of a full search
+// built with "make microbench", linked against everything except the uai entry point
+#include "global_includes.h"
+#include "board.h"
+#include "move.h"
+#include "nnue.h"
+#include "tests.h"
+#include <iomanip>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+// keeps the compiler from throwing away results or hoisting calls out of the timed loops
+template <typename T>
+inline void doNotOptimize(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// a position followed by the moves played from it
+struct MoveStream {
+    std::string fen;
+    std::vector<Move> moves;
+};
+
+struct MicrobenchSettings {
+    int repetitions = 20;
+    int warmup = 2;
+    // -1 leaves the thread wherever the scheduler puts it
+    int cpu = 0;
+    // calls per position for the primitives that don't change the board
+    int batch = 64;
+    std::string file;
+};
+
+// sees the private parts of the board so flips can be timed on their own
+struct BoardBenchmark {
+    static int64_t timeFlips(Board &board, const Move move, const int batch, const bool restoreOnly) {
+        const BoardState state = board.currentState;
+        const Accumulator accumulator = board.accumulator;
+        const auto begin = std::chrono::steady_clock::now();
+        for(int i = 0; i < batch; i++) {
+            if(!restoreOnly) {
+                if(board.sideToMove == X) {
+                    board.flipNeighboringTiles<X>(move.getEndSquare());
+                } else {
+                    board.flipNeighboringTiles<O>(move.getEndSquare());
+                }
+            }
+            doNotOptimize(board.currentState);
+            board.currentState = state;
+            board.accumulator = accumulator;
+        }
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+    }
+};
+
+// the same syntax as the position command: startpos or fen <fen>, then optionally moves ...
+std::vector<MoveStream> loadStreams(const std::string &path) {
+    std::vector<MoveStream> streams;
+    std::ifstream input(path);
+    std::string line;
+    while(std::getline(input, line)) {
+        std::vector<std::string> bits;
+        std::istringstream stream(line);
+        std::string bit;
+        while(stream >> bit) bits.push_back(bit);
+        if(bits.empty()) continue;
+        MoveStream moveStream;
+        size_t i = 0;
+        if(bits[0] == "startpos") {
+            moveStream.fen = "x5o/7/7/7/7/7/o5x x 0 1";
+            i = 1;
+        } else if(bits[0] == "fen" && bits.size() >= 5) {
+            moveStream.fen = bits[1] + " " + bits[2] + " " + bits[3] + " " + bits[4];
+            i = 5;
+        } else {
+            std::cout << "skipping invalid line: " << line << std::endl;
+            continue;
+        }
+        if(i < bits.size() && bits[i] == "moves") i++;
+        // a stream stops at the first move that isn't legal, the board asserts on those
+        auto board = std::make_unique<Board>(moveStream.fen);
+        std::array<Move, 194> moves;
+        for(; i < bits.size() && static_cast<int>(moveStream.moves.size()) < maxHistory - 1; i++) {
+            const Move move(bits[i]);
+            const int moveCount = board->getMoves(moves);
+            if(std::find(moves.begin(), moves.begin() + moveCount, move) == moves.begin() + moveCount) {
+                std::cout << "stopping at illegal move " << bits[i] << " in: " << line << std::endl;
+                break;
+            }
+            board->makeMove(move);
+            moveStream.moves.push_back(move);
+        }
+        streams.push_back(moveStream);
+    }
+    return streams;
+}
+
+// without a file, games are played out from startpos and the bench positions
+// each side mostly plays the move with the best static eval so the positions look like real games
+std::vector<MoveStream> generateStreams() {
+    std::vector<std::string> fens = {"x5o/7/7/7/7/7/o5x x 0 1"};
+    fens.insert(fens.end(), benchPositions.begin(), benchPositions.end());
+    std::mt19937_64 rng(20240101);
+    std::vector<MoveStream> streams;
+    for(const std::string &fen : fens) {
+        MoveStream stream{fen, {}};
+        auto board = std::make_unique<Board>(fen);
+        std::array<Move, 194> moves;
+        while(board->getGameState() == StillGoing && static_cast<int>(stream.moves.size()) < 300) {
+            const int moveCount = board->getMoves(moves);
+            if(moveCount == 0) break;
+            int bestIndex = rng() % moveCount;
+            // one move in ten is random, the rest are greedy
+            if(rng() % 10 != 0) {
+                int bestScore = -1000000;
+                for(int i = 0; i < moveCount; i++) {
+                    board->makeMove(moves[i]);
+                    const int score = -board->getEval();
+                    board->undoMove();
+                    if(score > bestScore) {
+                        bestScore = score;
+                        bestIndex = i;
+                    }
+                }
+            }
+            board->makeMove(moves[bestIndex]);
+            stream.moves.push_back(moves[bestIndex]);
+        }
+        streams.push_back(stream);
+    }
+    return streams;
+}
+
+enum Primitives {
+    MakeMove, UndoMove, GetMoves, GetMoveCount, GetGameState, GetEval, FlipNeighboringTiles, PrimitiveCount
+};
+
+const std::array<std::string, PrimitiveCount> primitiveNames = {
+    "makeMove", "undoMove", "getMoves", "getMoveCount", "getGameState", "getEval", "flipNeighboringTiles"
+};
+
+struct Sample {
+    int64_t nanoseconds = 0;
+    uint64_t operations = 0;
+};
+
+// a batch of calls to a const primitive on the current position
+template <typename Function>
+void timeBatch(Sample &sample, const int batch, Function function) {
+    const auto begin = std::chrono::steady_clock::now();
+    for(int i = 0; i < batch; i++) {
+        doNotOptimize(function());
+    }
+    sample.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+    sample.operations += batch;
+}
+
+// one pass over every stream, timing each primitive
+std::array<Sample, PrimitiveCount> runPass(const std::vector<MoveStream> &streams, const int batch) {
+    std::array<Sample, PrimitiveCount> samples{};
+    Sample flipBaseline;
+    std::array<Move, 194> moves;
+    for(const MoveStream &stream : streams) {
+        auto board = std::make_unique<Board>(stream.fen);
+        // the whole stream is played forwards then taken back, so make and undo are timed over real sequences
+        auto begin = std::chrono::steady_clock::now();
+        for(const Move move : stream.moves) {
+            board->makeMove(move);
+        }
+        samples[MakeMove].nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+        samples[MakeMove].operations += stream.moves.size();
+
+        begin = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < stream.moves.size(); i++) {
+            board->undoMove();
+        }
+        samples[UndoMove].nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+        samples[UndoMove].operations += stream.moves.size();
+
+        // the queries are timed on every position along the stream
+        for(const Move move : stream.moves) {
+            timeBatch(samples[GetMoves], batch, [&]() { return board->getMoves(moves); });
+            timeBatch(samples[GetMoveCount], batch, [&]() { return board->getMoveCount(); });
+            timeBatch(samples[GetGameState], batch, [&]() { return board->getGameState(); });
+            timeBatch(samples[GetEval], batch, [&]() { return board->getEval(); });
+            if(move.getFlag() != Passing) {
+                samples[FlipNeighboringTiles].nanoseconds += BoardBenchmark::timeFlips(*board, move, batch, false);
+                samples[FlipNeighboringTiles].operations += batch;
+                flipBaseline.nanoseconds += BoardBenchmark::timeFlips(*board, move, batch, true);
+            }
+            board->makeMove(move);
+        }
+    }
+    // restoring the state between flips isn't part of the cost
+    samples[FlipNeighboringTiles].nanoseconds = std::max<int64_t>(samples[FlipNeighboringTiles].nanoseconds - flipBaseline.nanoseconds, 0);
+    return samples;
+}
+
+void pinThread(const int cpu) {
+    if(cpu < 0) return;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if(sched_setaffinity(0, sizeof(set), &set) != 0) {
+        std::cout << "couldn't pin to cpu " << cpu << std::endl;
+    }
+#else
+    std::cout << "pinning is only supported on linux" << std::endl;
+#endif
+}
+
+// microbench [reps <n>] [warmup <n>] [cpu <n>] [batch <n>] [file <path>]
+MicrobenchSettings parseSettings(const int argc, char* argv[]) {
+    MicrobenchSettings settings;
+    for(int i = 1; i + 1 < argc; i += 2) {
+        const std::string name = argv[i];
+        const std::string value = argv[i + 1];
+        if(name == "reps") {
+            settings.repetitions = std::max(std::stoi(value), 1);
+        } else if(name == "warmup") {
+            settings.warmup = std::max(std::stoi(value), 0);
+        } else if(name == "cpu") {
+            settings.cpu = std::stoi(value);
+        } else if(name == "batch") {
+            settings.batch = std::max(std::stoi(value), 1);
+        } else if(name == "file") {
+            settings.file = value;
+        } else {
+            std::cout << "unknown option " << name << std::endl;
+        }
+    }
+    return settings;
+}
+
+int main(int argc, char* argv[]) {
+    initializeZobrist();
+    initializeNetwork();
+    const MicrobenchSettings settings = parseSettings(argc, argv);
+    pinThread(settings.cpu);
+
+    const std::vector<MoveStream> streams = settings.file.empty() ? generateStreams() : loadStreams(settings.file);
+    size_t plies = 0;
+    for(const MoveStream &stream : streams) {
+        plies += stream.moves.size();
+    }
+    if(plies == 0) {
+        std::cout << "no moves to replay" << std::endl;
+        return 1;
+    }
+    std::cout << streams.size() << " streams, " << plies << " moves, " << settings.warmup << " warmup and "
+        << settings.repetitions << " timed repetitions" << std::endl;
+
+    for(int i = 0; i < settings.warmup; i++) {
+        runPass(streams, settings.batch);
+    }
+    // nanoseconds per operation, results[primitive][repetition]
+    std::array<std::vector<double>, PrimitiveCount> results;
+    for(int i = 0; i < settings.repetitions; i++) {
+        const auto samples = runPass(streams, settings.batch);
+        for(int primitive = 0; primitive < PrimitiveCount; primitive++) {
+            const Sample &sample = samples[primitive];
+            results[primitive].push_back(sample.operations == 0 ? 0.0 : double(sample.nanoseconds) / sample.operations);
+        }
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::left << std::setw(22) << "primitive" << std::right << std::setw(10) << "mean ns" << std::setw(10) << "sd"
+        << std::setw(10) << "min" << std::setw(10) << "median" << std::endl;
+    for(int primitive = 0; primitive < PrimitiveCount; primitive++) {
+        std::vector<double> &values = results[primitive];
+        const double mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+        double squares = 0;
+        for(const double value : values) {
+            squares += (value - mean) * (value - mean);
+        }
+        const double deviation = values.size() > 1 ? std::sqrt(squares / (values.size() - 1)) : 0.0;
+        std::sort(values.begin(), values.end());
+        const double median = values.size() % 2 == 1 ? values[values.size() / 2] : (values[values.size() / 2 - 1] + values[values.size() / 2]) / 2;
+        std::cout << std::left << std::setw(22) << primitiveNames[primitive] << std::right << std::setw(10) << mean << std::setw(10) << deviation
+            << std::setw(10) << values.front() << std::setw(10) << median << std::endl;
+    }
+    return 0;
+}